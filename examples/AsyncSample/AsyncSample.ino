@@ -17,6 +17,15 @@ void OnLog(const char* gsmLog)
 }
 
 SimcomAtCommands gsm(Serial2, UpdateBaudRate);
+int16_t signalQuality = 0;
+
+void OnSignalQuality(AtCommand command, AtResultType result, void* state)
+{
+	if (result == AtResultType::Success)
+	{
+		Serial.printf("Signal quality: %d\n", signalQuality);
+	}
+}
 
 void setup()
 {
@@ -32,10 +41,16 @@ void setup()
 // the loop function runs over and over again until power down or reset
 void loop() 
 {
-	gsm.EnsureModemConnected(115200);
+	if (!gsm.IsBusy())
+	{
+		gsm.EnsureModemConnected(115200);
+		gsm.GetSignalQualityAsync(signalQuality, OnSignalQuality);
+	}
+	// returns immediately, command completes in OnSignalQuality callback
+	gsm.Poll();
+
 	ui.Clear();
 	FixedString20 msg = "Test";
 	ui.DrawFramePopup(msg);
 	ui.Draw();
-	gsm.wait(1000);
 }
@@ -25,15 +25,15 @@ void OnLog(const char* gsmLog)
 }
 int receivedBytes = 0;
 
-void OnDataReceived(uint8_t mux, FixedStringBase &data)
+void OnDataReceived(uint8_t mux, const uint8_t *data, size_t length)
 {
 	if (connectionValidator.HasError())
 	{
 		return;
 	}
-	receivedBytes += data.length();
-	Serial.printf("Received %d bytes\n", data.length());
-	for (int i = 0; i < data.length(); i++)
+	receivedBytes += length;
+	Serial.printf("Received %d bytes\n", static_cast<int>(length));
+	for (size_t i = 0; i < length; i++)
 	{
 		connectionValidator.ValidateIncomingByte(data[i], i, receivedBytes);
 	}
@@ -132,14 +132,11 @@ void loop()
 
 void ReadDataFromConnection()
 {
-	FixedString20 buffer;
-	while (gsmAt.Read(0, buffer) == AtResultType::Success)
+	static uint8_t buffer[CIPRXGET_MAX_LENGTH];
+	size_t readBytes;
+	// modem notifies about new data with +CIPRXGET: 1,0, no need to ask it
+	if (gsmAt.IsDataPending(0) && gsmAt.ReadAll(0, buffer, sizeof(buffer), readBytes) == AtResultType::Success)
 	{
-		if (buffer.length() == 0)
-		{
-			return;
-		}
-		OnDataReceived(0, buffer);
-		buffer.clear();
+		OnDataReceived(0, buffer, readBytes);
 	}
 }
@@ -0,0 +1,249 @@
+#include "FdStream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+/* kernel uart buffer size is not exposed, this is the usual 8250/usb-serial value */
+#define FD_STREAM_WRITE_BUFFER_SIZE 4096
+
+static speed_t ToSpeed(int baudRate)
+{
+	switch (baudRate)
+	{
+	case 1200: return B1200;
+	case 2400: return B2400;
+	case 4800: return B4800;
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	case 460800: return B460800;
+	case 921600: return B921600;
+	default: return B0;
+	}
+}
+
+FdStream::FdStream() :
+	_fd(-1),
+	_ownsFd(false),
+	_peeked(-1)
+{
+}
+
+FdStream::~FdStream()
+{
+	Close();
+}
+
+bool FdStream::ConfigureRaw(int fd, int baudRate)
+{
+	termios tty;
+	if (tcgetattr(fd, &tty) != 0)
+	{
+		return false;
+	}
+	cfmakeraw(&tty);
+	tty.c_cflag |= CLOCAL | CREAD;
+	tty.c_cflag &= ~CRTSCTS;
+	tty.c_cc[VMIN] = 0;
+	tty.c_cc[VTIME] = 0;
+	if (baudRate > 0)
+	{
+		const auto speed = ToSpeed(baudRate);
+		if (speed == B0)
+		{
+			return false;
+		}
+		cfsetispeed(&tty, speed);
+		cfsetospeed(&tty, speed);
+	}
+	return tcsetattr(fd, TCSANOW, &tty) == 0;
+}
+
+bool FdStream::Open(const char *path, int baudRate)
+{
+	Close();
+	const auto fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+	{
+		return false;
+	}
+	if (!ConfigureRaw(fd, baudRate))
+	{
+		::close(fd);
+		return false;
+	}
+	tcflush(fd, TCIOFLUSH);
+	_fd = fd;
+	_ownsFd = true;
+	return true;
+}
+
+bool FdStream::OpenPty(char *slavePath, size_t slavePathSize)
+{
+	Close();
+	const auto fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+	{
+		return false;
+	}
+	if (grantpt(fd) != 0 || unlockpt(fd) != 0 || ptsname_r(fd, slavePath, slavePathSize) != 0 || !ConfigureRaw(fd, 0))
+	{
+		::close(fd);
+		return false;
+	}
+	_fd = fd;
+	_ownsFd = true;
+	return true;
+}
+
+void FdStream::Attach(int fd)
+{
+	Close();
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	_fd = fd;
+	_ownsFd = false;
+}
+
+void FdStream::Close()
+{
+	if (_fd >= 0 && _ownsFd)
+	{
+		::close(_fd);
+	}
+	_fd = -1;
+	_ownsFd = false;
+	_peeked = -1;
+}
+
+bool FdStream::SetBaudRate(int baudRate)
+{
+	if (_fd < 0 || !ConfigureRaw(_fd, baudRate))
+	{
+		return false;
+	}
+	tcflush(_fd, TCIOFLUSH);
+	_peeked = -1;
+	return true;
+}
+
+int FdStream::available()
+{
+	if (_fd < 0)
+	{
+		return 0;
+	}
+	int count = 0;
+	if (ioctl(_fd, FIONREAD, &count) != 0)
+	{
+		count = 0;
+	}
+	return count + (_peeked >= 0 ? 1 : 0);
+}
+
+int FdStream::read()
+{
+	if (_peeked >= 0)
+	{
+		const auto c = _peeked;
+		_peeked = -1;
+		return c;
+	}
+	uint8_t c;
+	if (_fd < 0 || ::read(_fd, &c, 1) != 1)
+	{
+		return -1;
+	}
+	return c;
+}
+
+int FdStream::peek()
+{
+	if (_peeked < 0)
+	{
+		_peeked = read();
+	}
+	return _peeked;
+}
+
+size_t FdStream::readBytes(uint8_t *buffer, size_t length)
+{
+	size_t count = 0;
+	if (length > 0 && _peeked >= 0)
+	{
+		buffer[count++] = static_cast<uint8_t>(_peeked);
+		_peeked = -1;
+	}
+	if (count < length && _fd >= 0)
+	{
+		const auto n = ::read(_fd, buffer + count, length - count);
+		if (n > 0)
+		{
+			count += n;
+		}
+	}
+	// block for the rest like Arduino Stream does
+	if (count < length)
+	{
+		count += Stream::readBytes(buffer + count, length - count);
+	}
+	return count;
+}
+
+size_t FdStream::write(uint8_t c)
+{
+	return write(&c, 1);
+}
+
+size_t FdStream::write(const uint8_t *buffer, size_t size)
+{
+	size_t written = 0;
+	while (_fd >= 0 && written < size)
+	{
+		const auto n = ::write(_fd, buffer + written, size - written);
+		if (n > 0)
+		{
+			written += n;
+			continue;
+		}
+		if (n < 0 && errno != EAGAIN && errno != EINTR)
+		{
+			break;
+		}
+		pollfd pfd = { _fd, POLLOUT, 0 };
+		if (poll(&pfd, 1, static_cast<int>(_timeout)) <= 0)
+		{
+			break;
+		}
+	}
+	return written;
+}
+
+int FdStream::availableForWrite()
+{
+	if (_fd < 0)
+	{
+		return 0;
+	}
+	int queued = 0;
+	if (ioctl(_fd, TIOCOUTQ, &queued) != 0)
+	{
+		queued = 0;
+	}
+	return queued < FD_STREAM_WRITE_BUFFER_SIZE ? FD_STREAM_WRITE_BUFFER_SIZE - queued : 0;
+}
+
+void FdStream::flush()
+{
+	if (_fd >= 0)
+	{
+		tcdrain(_fd);
+	}
+}
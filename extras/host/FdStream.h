@@ -0,0 +1,46 @@
+#ifndef _FD_STREAM_H
+#define _FD_STREAM_H
+
+#include <Stream.h>
+
+/*
+Stream over file descriptor of serial port (/dev/ttyUSB0) or pseudo terminal.
+Port is switched to raw mode, reads never block
+*/
+class FdStream : public Stream
+{
+	int _fd;
+	bool _ownsFd;
+	int _peeked;
+	static bool ConfigureRaw(int fd, int baudRate);
+public:
+	FdStream();
+	~FdStream();
+	bool Open(const char *path, int baudRate);
+	/* creates pseudo terminal, other side (e.g. modem simulator or socat) opens slavePath */
+	bool OpenPty(char *slavePath, size_t slavePathSize);
+	void Attach(int fd);
+	void Close();
+	bool IsOpen() const
+	{
+		return _fd >= 0;
+	}
+	int Fd() const
+	{
+		return _fd;
+	}
+	bool SetBaudRate(int baudRate);
+
+	int available() override;
+	int read() override;
+	int peek() override;
+	size_t readBytes(uint8_t *buffer, size_t length) override;
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	int availableForWrite() override;
+	void flush() override;
+	using Print::write;
+	using Stream::readBytes;
+};
+
+#endif
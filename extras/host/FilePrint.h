@@ -0,0 +1,45 @@
+#ifndef _FILE_PRINT_H
+#define _FILE_PRINT_H
+
+#include <Print.h>
+#include <stdio.h>
+
+/* Print writing to stdio file, used as UartTraceRecorder output */
+class FilePrint : public Print
+{
+	FILE *_file;
+public:
+	FilePrint() :
+		_file(nullptr)
+	{
+	}
+	~FilePrint()
+	{
+		Close();
+	}
+	bool Open(const char *path)
+	{
+		Close();
+		_file = fopen(path, "wb");
+		return _file != nullptr;
+	}
+	void Close()
+	{
+		if (_file != nullptr)
+		{
+			fclose(_file);
+			_file = nullptr;
+		}
+	}
+	size_t write(uint8_t c) override
+	{
+		return _file != nullptr && fputc(c, _file) != EOF ? 1 : 0;
+	}
+	size_t write(const uint8_t *buffer, size_t size) override
+	{
+		return _file != nullptr ? fwrite(buffer, 1, size, _file) : 0;
+	}
+	using Print::write;
+};
+
+#endif
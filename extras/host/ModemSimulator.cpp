@@ -0,0 +1,801 @@
+#include "ModemSimulator.h"
+
+#include <Arduino.h>
+#include <algorithm>
+#include <stdio.h>
+
+/* single CIPRXGET read returns at most this many bytes, same as SIM800 */
+#define SIMULATOR_MAX_RX_READ 1460
+/* ESP32 UART TX FIFO size */
+#define SIMULATOR_WRITE_BUFFER_SIZE 128
+
+static std::string Line(const std::string& text)
+{
+	return "\r\n" + text + "\r\n";
+}
+
+static bool StartsWith(const std::string& str, const char *prefix)
+{
+	return str.compare(0, strlen(prefix), prefix) == 0;
+}
+
+ModemSimulator::ModemSimulator(uint32_t seed) :
+	_clock(nullptr),
+	_lastByteReadyAt(0),
+	_randomState(seed == 0 ? 1 : seed),
+	_baudRate(115200),
+	_defaultLatencyMs(10),
+	_connectLatencyMs(500),
+	_ussdLatencyMs(2000),
+	_garbageProbability(0),
+	_dropProbability(0),
+	_garbageBytes(0),
+	_droppedBytes(0),
+	_echo(true),
+	_simStatus("READY"),
+	_registrationStatus(1),
+	_signalQuality(20),
+	_batteryPercent(90),
+	_batteryVoltageMv(4100),
+	_operatorName("Simulated"),
+	_operatorNumeric("00101"),
+	_copsFormat(0),
+	_imei("865067020395128"),
+	_ipState("IP INITIAL"),
+	_ipAddress("10.0.0.2"),
+	_ussdResponse("Balance 0.00"),
+	_connectSucceeds(true),
+	_cipmux(false),
+	_cipqsend(false),
+	_rxManual(false),
+	_cipsendMux(-1),
+	_cipsendLength(0),
+	_cipsendLineFeedPending(false),
+	_sendWindow(SIMULATOR_SEND_WINDOW)
+{
+	for (auto& connection : _connections)
+	{
+		connection.State = ConnectionState::Initial;
+		connection.Port = 0;
+		connection.TxLength = 0;
+	}
+}
+
+void ModemSimulator::SetClock(VirtualClock &clock)
+{
+	_clock = &clock;
+	_output.clear();
+	_scheduled.clear();
+	_lastByteReadyAt = 0;
+}
+
+void ModemSimulator::SetBaudRate(int baudRate)
+{
+	_baudRate = baudRate;
+}
+
+void ModemSimulator::SetDefaultLatency(unsigned long latencyMs)
+{
+	_defaultLatencyMs = latencyMs;
+}
+
+void ModemSimulator::SetCommandLatency(const char *prefix, unsigned long latencyMs)
+{
+	for (auto& latency : _latencies)
+	{
+		if (latency.Prefix == prefix)
+		{
+			latency.LatencyMs = latencyMs;
+			return;
+		}
+	}
+	_latencies.push_back({ prefix, latencyMs });
+}
+
+void ModemSimulator::SetConnectLatency(unsigned long latencyMs)
+{
+	_connectLatencyMs = latencyMs;
+}
+
+void ModemSimulator::SetUssdLatency(unsigned long latencyMs)
+{
+	_ussdLatencyMs = latencyMs;
+}
+
+void ModemSimulator::SetGarbageProbability(double probability)
+{
+	_garbageProbability = probability;
+}
+
+void ModemSimulator::SetDropProbability(double probability)
+{
+	_dropProbability = probability;
+}
+
+void ModemSimulator::SetSimStatus(const char *status)
+{
+	_simStatus = status;
+}
+
+void ModemSimulator::SetRegistrationStatus(int status)
+{
+	_registrationStatus = status;
+}
+
+void ModemSimulator::SetSignalQuality(int rssi)
+{
+	_signalQuality = rssi;
+}
+
+void ModemSimulator::SetBattery(int percent, int voltageMv)
+{
+	_batteryPercent = percent;
+	_batteryVoltageMv = voltageMv;
+}
+
+void ModemSimulator::SetOperator(const char *name, const char *numeric)
+{
+	_operatorName = name;
+	_operatorNumeric = numeric;
+}
+
+void ModemSimulator::SetImei(const char *imei)
+{
+	_imei = imei;
+}
+
+void ModemSimulator::SetIpAddress(const char *ipAddress)
+{
+	_ipAddress = ipAddress;
+}
+
+void ModemSimulator::SetUssdResponse(const char *response)
+{
+	_ussdResponse = response;
+}
+
+void ModemSimulator::SetSendWindow(size_t bytes)
+{
+	_sendWindow = bytes;
+}
+
+void ModemSimulator::SetConnectSucceeds(bool succeeds)
+{
+	_connectSucceeds = succeeds;
+}
+
+ModemSimulator::Connection& ModemSimulator::GetConnection(uint8_t mux)
+{
+	return _connections[mux % SIMULATOR_MAX_CONNECTIONS];
+}
+
+void ModemSimulator::ReceiveData(uint8_t mux, const char *data, size_t length)
+{
+	auto& connection = GetConnection(mux);
+	const auto wasEmpty = connection.Received.empty();
+	connection.Received.append(data, length);
+
+	char header[32];
+	if (_rxManual)
+	{
+		// modem notifies only when buffer becomes non empty
+		if (wasEmpty)
+		{
+			snprintf(header, sizeof(header), "+CIPRXGET: 1,%d", mux);
+			Schedule(Line(header), 0);
+		}
+		return;
+	}
+	snprintf(header, sizeof(header), "\r\n+RECEIVE,%d,%u:\r\n", mux, static_cast<unsigned>(connection.Received.size()));
+	Schedule(header + connection.Received, 0);
+	connection.Received.clear();
+}
+
+void ModemSimulator::CloseRemote(uint8_t mux)
+{
+	char event[24];
+	snprintf(event, sizeof(event), "%d, CLOSED", mux);
+	Schedule(Line(event), 0, mux, ConnectionState::Closed);
+}
+
+void ModemSimulator::SendUnsolicited(const char *line)
+{
+	Schedule(Line(line), 0);
+}
+
+unsigned long ModemSimulator::Now()
+{
+	return _clock != nullptr ? _clock->Micros() : micros();
+}
+
+/* xorshift, sequence depends only on seed so runs are reproducible */
+double ModemSimulator::NextRandom()
+{
+	_randomState ^= _randomState << 13;
+	_randomState ^= _randomState >> 17;
+	_randomState ^= _randomState << 5;
+	return static_cast<double>(_randomState) / 4294967296.0;
+}
+
+void ModemSimulator::Emit(const std::string& text, unsigned long dueAt)
+{
+	const unsigned long byteTimeUs = _baudRate > 0 ? 10000000UL / _baudRate : 0;
+	auto readyAt = std::max(dueAt, _lastByteReadyAt);
+
+	for (auto c : text)
+	{
+		readyAt += byteTimeUs;
+		if (_dropProbability > 0 && NextRandom() < _dropProbability)
+		{
+			_droppedBytes++;
+			continue;
+		}
+		_output.push_back({ static_cast<uint8_t>(c), readyAt });
+	}
+	_lastByteReadyAt = readyAt;
+}
+
+std::string ModemSimulator::Garbage()
+{
+	std::string garbage;
+	if (_garbageProbability > 0 && NextRandom() < _garbageProbability)
+	{
+		const auto count = 1 + static_cast<int>(NextRandom() * 8);
+		for (int i = 0; i < count; i++)
+		{
+			garbage += static_cast<char>(0x80 + static_cast<int>(NextRandom() * 0x80));
+		}
+		_garbageBytes += count;
+	}
+	return garbage;
+}
+
+void ModemSimulator::Schedule(const std::string& text, unsigned long delayMs, int mux, ConnectionState state)
+{
+	_scheduled.push_back({ Now() + delayMs * 1000, text, mux, state });
+	Pump();
+}
+
+void ModemSimulator::Pump()
+{
+	const auto now = Now();
+	while (!_scheduled.empty())
+	{
+		auto next = std::min_element(_scheduled.begin(), _scheduled.end(),
+			[](const ScheduledOutput& a, const ScheduledOutput& b) { return a.DueAt < b.DueAt; });
+		if (next->DueAt > now)
+		{
+			return;
+		}
+		const auto output = *next;
+		_scheduled.erase(next);
+		if (output.Mux >= 0)
+		{
+			GetConnection(output.Mux).State = output.State;
+		}
+		Emit(Garbage() + output.Text, output.DueAt);
+	}
+}
+
+void ModemSimulator::EchoByte(uint8_t c)
+{
+	if (_echo)
+	{
+		Emit(std::string(1, static_cast<char>(c)), Now());
+	}
+}
+
+unsigned long ModemSimulator::LatencyFor(const std::string& commandLine)
+{
+	size_t bestLength = 0;
+	auto latencyMs = _defaultLatencyMs;
+	for (auto& latency : _latencies)
+	{
+		if (latency.Prefix.size() > bestLength && StartsWith(commandLine, latency.Prefix.c_str()))
+		{
+			bestLength = latency.Prefix.size();
+			latencyMs = latency.LatencyMs;
+		}
+	}
+	return latencyMs;
+}
+
+int ModemSimulator::available()
+{
+	Pump();
+	const auto now = Now();
+	int count = 0;
+	for (auto& outputByte : _output)
+	{
+		if (outputByte.ReadyAt > now)
+		{
+			break;
+		}
+		count++;
+	}
+	return count;
+}
+
+int ModemSimulator::read()
+{
+	const auto c = peek();
+	if (c >= 0)
+	{
+		_output.pop_front();
+	}
+	return c;
+}
+
+int ModemSimulator::peek()
+{
+	Pump();
+	if (_output.empty() || _output.front().ReadyAt > Now())
+	{
+		return -1;
+	}
+	return _output.front().Value;
+}
+
+int ModemSimulator::availableForWrite()
+{
+	return SIMULATOR_WRITE_BUFFER_SIZE;
+}
+
+size_t ModemSimulator::write(uint8_t c)
+{
+	Pump();
+	if (_cipsendMux >= 0)
+	{
+		// LF terminating AT+CIPSEND line is not part of payload
+		if (!(c == '\n' && _cipsendData.empty() && _cipsendLineFeedPending))
+		{
+			CipsendDataReceived(c);
+		}
+		_cipsendLineFeedPending = false;
+		return 1;
+	}
+	EchoByte(c);
+	if (c == '\r')
+	{
+		ExecuteLine(_commandLine);
+		_commandLine.clear();
+	}
+	else if (c != '\n')
+	{
+		_commandLine += static_cast<char>(c);
+	}
+	return 1;
+}
+
+void ModemSimulator::CipsendDataReceived(uint8_t c)
+{
+	EchoByte(c);
+	_cipsendData += static_cast<char>(c);
+	if (_cipsendData.size() < _cipsendLength)
+	{
+		return;
+	}
+	auto& connection = GetConnection(_cipsendMux);
+	const auto accepted = _cipsendLength < _sendWindow ? _cipsendLength : _sendWindow;
+	connection.Sent += _cipsendData.substr(0, accepted);
+	connection.TxLength += accepted;
+
+	char result[32];
+	if (_cipqsend)
+	{
+		snprintf(result, sizeof(result), "DATA ACCEPT:%d,%u", _cipsendMux, static_cast<unsigned>(accepted));
+	}
+	else
+	{
+		snprintf(result, sizeof(result), "%d, SEND OK", _cipsendMux);
+	}
+	Schedule(Line(result), LatencyFor("AT+CIPSEND"));
+	_cipsendMux = -1;
+	_cipsendData.clear();
+}
+
+void ModemSimulator::ExecuteLine(const std::string& line)
+{
+	if (line.size() < 2 || line[0] != 'A' || line[1] != 'T')
+	{
+		return;
+	}
+	const auto latencyMs = LatencyFor(line);
+
+	// split AT+CREG?;+CSQ;E1 into parts, semicolons inside quotes are not separators
+	std::vector<std::string> parts;
+	std::string part;
+	bool inQuotes = false;
+	for (size_t i = 2; i < line.size(); i++)
+	{
+		const auto c = line[i];
+		if (c == '"')
+		{
+			inQuotes = !inQuotes;
+		}
+		if (c == ';' && !inQuotes)
+		{
+			parts.push_back(part);
+			part.clear();
+			continue;
+		}
+		part += c;
+	}
+	if (!part.empty() || parts.empty())
+	{
+		parts.push_back(part);
+	}
+
+	std::string response;
+	auto result = PartResult::Ok;
+	for (auto& commandPart : parts)
+	{
+		result = ExecutePart(commandPart, response, latencyMs);
+		if (result == PartResult::Error)
+		{
+			response += Line("ERROR");
+			break;
+		}
+	}
+	if (result == PartResult::Ok)
+	{
+		response += Line("OK");
+	}
+	Schedule(response, latencyMs);
+}
+
+ModemSimulator::PartResult ModemSimulator::ExecutePart(const std::string& part, std::string& response, unsigned long latencyMs)
+{
+	char buffer[64];
+	int value;
+	if (part.empty())
+	{
+		return PartResult::Ok;
+	}
+	if (part == "E0" || part == "E1")
+	{
+		_echo = part == "E1";
+		return PartResult::Ok;
+	}
+	if (part == "+CPIN?")
+	{
+		if (_simStatus.empty())
+		{
+			return PartResult::Error;
+		}
+		response += Line("+CPIN: " + _simStatus);
+		return PartResult::Ok;
+	}
+	if (part == "+CREG?")
+	{
+		snprintf(buffer, sizeof(buffer), "+CREG: 0,%d", _registrationStatus);
+		response += Line(buffer);
+		return PartResult::Ok;
+	}
+	if (part == "+CSQ")
+	{
+		snprintf(buffer, sizeof(buffer), "+CSQ: %d,0", _signalQuality);
+		response += Line(buffer);
+		return PartResult::Ok;
+	}
+	if (part == "+CBC")
+	{
+		snprintf(buffer, sizeof(buffer), "+CBC: 0,%d,%d", _batteryPercent, _batteryVoltageMv);
+		response += Line(buffer);
+		return PartResult::Ok;
+	}
+	if (part == "+COPS?")
+	{
+		if (_registrationStatus != 1 && _registrationStatus != 5)
+		{
+			response += Line("+COPS: 0");
+			return PartResult::Ok;
+		}
+		const auto& name = _copsFormat == 2 ? _operatorNumeric : _operatorName;
+		snprintf(buffer, sizeof(buffer), "+COPS: 0,%d,\"%s\"", _copsFormat, name.c_str());
+		response += Line(buffer);
+		return PartResult::Ok;
+	}
+	if (sscanf(part.c_str(), "+COPS=3,%d", &value) == 1)
+	{
+		_copsFormat = value;
+		return PartResult::Ok;
+	}
+	if (part == "+CLCC")
+	{
+		return PartResult::Ok;
+	}
+	if (part == "+GSN")
+	{
+		response += Line(_imei);
+		return PartResult::Ok;
+	}
+	if (part == "+CIPMUX?")
+	{
+		snprintf(buffer, sizeof(buffer), "+CIPMUX: %d", _cipmux ? 1 : 0);
+		response += Line(buffer);
+		return PartResult::Ok;
+	}
+	if (sscanf(part.c_str(), "+CIPMUX=%d", &value) == 1)
+	{
+		_cipmux = value == 1;
+		return PartResult::Ok;
+	}
+	if (part == "+CIPQSEND?")
+	{
+		snprintf(buffer, sizeof(buffer), "+CIPQSEND: %d", _cipqsend ? 1 : 0);
+		response += Line(buffer);
+		return PartResult::Ok;
+	}
+	if (sscanf(part.c_str(), "+CIPQSEND=%d", &value) == 1)
+	{
+		_cipqsend = value == 1;
+		return PartResult::Ok;
+	}
+	if (StartsWith(part, "+CIPRXGET"))
+	{
+		return ExecuteCipRxGet(part.substr(9), response);
+	}
+	if (StartsWith(part, "+CIPSTATUS"))
+	{
+		if (sscanf(part.c_str(), "+CIPSTATUS=%d", &value) == 1)
+		{
+			auto& connection = GetConnection(value);
+			if (connection.State == ConnectionState::Initial)
+			{
+				snprintf(buffer, sizeof(buffer), "+CIPSTATUS: %d,,\"\",\"\",\"\",\"INITIAL\"", value);
+			}
+			else
+			{
+				snprintf(buffer, sizeof(buffer), "+CIPSTATUS: %d,0,\"%s\",\"%s\",\"%d\",\"%s\"", value,
+					connection.Protocol.c_str(), connection.Address.c_str(), connection.Port, ConnectionStateToStr(connection.State));
+			}
+			response += Line(buffer);
+			return PartResult::Ok;
+		}
+		return ExecuteCipStatus(response);
+	}
+	if (StartsWith(part, "+CIPSTART="))
+	{
+		return ExecuteCipStart(part.substr(10), response, latencyMs);
+	}
+	if (part == "+CIPSEND?")
+	{
+		for (int mux = 0; mux < (_cipmux ? SIMULATOR_MAX_CONNECTIONS : 1); mux++)
+		{
+			const int size = _connections[mux].State == ConnectionState::Connected ? static_cast<int>(_sendWindow) : 0;
+			if (_cipmux)
+			{
+				snprintf(buffer, sizeof(buffer), "+CIPSEND: %d,%d", mux, size);
+			}
+			else
+			{
+				snprintf(buffer, sizeof(buffer), "+CIPSEND: %d", size);
+			}
+			response += Line(buffer);
+		}
+		return PartResult::Ok;
+	}
+	if (part == "+CIPACK" || StartsWith(part, "+CIPACK="))
+	{
+		// remote side acknowledges everything right away
+		int mux = 0;
+		if (_cipmux && sscanf(part.c_str(), "+CIPACK=%d", &mux) != 1)
+		{
+			return PartResult::Error;
+		}
+		const auto& connection = GetConnection(mux);
+		if (connection.State != ConnectionState::Connected)
+		{
+			return PartResult::Error;
+		}
+		snprintf(buffer, sizeof(buffer), "+CIPACK: %u,%u,0", static_cast<unsigned>(connection.TxLength), static_cast<unsigned>(connection.TxLength));
+		response += Line(buffer);
+		return PartResult::Ok;
+	}
+	if (StartsWith(part, "+CIPSEND="))
+	{
+		return ExecuteCipSend(part.substr(9), response);
+	}
+	if (sscanf(part.c_str(), "+CIPCLOSE=%d", &value) == 1)
+	{
+		auto& connection = GetConnection(value);
+		if (connection.State != ConnectionState::Connected && connection.State != ConnectionState::Connecting)
+		{
+			return PartResult::Error;
+		}
+		// connect result of closed connection is never sent
+		_scheduled.erase(std::remove_if(_scheduled.begin(), _scheduled.end(),
+			[value](const ScheduledOutput& output) { return output.Mux == value; }), _scheduled.end());
+		connection.State = ConnectionState::Closed;
+		snprintf(buffer, sizeof(buffer), "%d, CLOSE OK", value);
+		response += Line(buffer);
+		return PartResult::NoFinalResult;
+	}
+	if (part == "+CIPSHUT")
+	{
+		for (auto& connection : _connections)
+		{
+			connection.State = ConnectionState::Initial;
+			connection.Received.clear();
+		}
+		_ipState = "IP INITIAL";
+		response += Line("SHUT OK");
+		return PartResult::NoFinalResult;
+	}
+	if (StartsWith(part, "+CSTT"))
+	{
+		_ipState = "IP START";
+		return PartResult::Ok;
+	}
+	if (part == "+CIICR")
+	{
+		if (_ipState != "IP START" || (_registrationStatus != 1 && _registrationStatus != 5))
+		{
+			return PartResult::Error;
+		}
+		_ipState = "IP GPRSACT";
+		return PartResult::Ok;
+	}
+	if (part == "+CIFSR")
+	{
+		if (_ipState == "IP INITIAL" || _ipState == "IP START")
+		{
+			return PartResult::Error;
+		}
+		if (_ipState == "IP GPRSACT")
+		{
+			_ipState = "IP STATUS";
+		}
+		response += Line(_ipAddress);
+		return PartResult::NoFinalResult;
+	}
+	if (StartsWith(part, "+CUSD=1,"))
+	{
+		snprintf(buffer, sizeof(buffer), "+CUSD: 0,\"%s\",15", _ussdResponse.c_str());
+		Schedule(Line(buffer), latencyMs + _ussdLatencyMs);
+		return PartResult::Ok;
+	}
+	if (StartsWith(part, "+CPOWD="))
+	{
+		response += Line("NORMAL POWER DOWN");
+		return PartResult::NoFinalResult;
+	}
+	if (StartsWith(part, "+IPR=") || StartsWith(part, "+CFUN=") || StartsWith(part, "+CIPMODE=") ||
+		StartsWith(part, "+CGATT") || StartsWith(part, "+CIPSPRT=") || StartsWith(part, "D") || part == "H")
+	{
+		return PartResult::Ok;
+	}
+	return PartResult::Error;
+}
+
+ModemSimulator::PartResult ModemSimulator::ExecuteCipStatus(std::string& response)
+{
+	response += Line("OK");
+	response += Line("STATE: " + _ipState);
+	if (!_cipmux)
+	{
+		return PartResult::NoFinalResult;
+	}
+	char buffer[80];
+	for (int mux = 0; mux < SIMULATOR_MAX_CONNECTIONS; mux++)
+	{
+		auto& connection = _connections[mux];
+		if (connection.State == ConnectionState::Initial)
+		{
+			snprintf(buffer, sizeof(buffer), "C: %d,,\"\",\"\",\"\",\"INITIAL\"", mux);
+		}
+		else
+		{
+			snprintf(buffer, sizeof(buffer), "C: %d,0,\"%s\",\"%s\",\"%d\",\"%s\"", mux,
+				connection.Protocol.c_str(), connection.Address.c_str(), connection.Port, ConnectionStateToStr(connection.State));
+		}
+		response += (mux == 0 ? "\r\n" : "") + std::string(buffer) + "\r\n";
+	}
+	return PartResult::NoFinalResult;
+}
+
+ModemSimulator::PartResult ModemSimulator::ExecuteCipStart(const std::string& args, std::string& response, unsigned long latencyMs)
+{
+	int mux;
+	char protocol[8];
+	char address[64];
+	int port;
+	if (sscanf(args.c_str(), "%d,\"%7[^\"]\",\"%63[^\"]\",\"%d\"", &mux, protocol, address, &port) != 4 ||
+		mux < 0 || mux >= SIMULATOR_MAX_CONNECTIONS)
+	{
+		return PartResult::Error;
+	}
+	auto& connection = _connections[mux];
+	char event[32];
+	if (connection.State == ConnectionState::Connected || connection.State == ConnectionState::Connecting)
+	{
+		snprintf(event, sizeof(event), "%d, ALREADY CONNECT", mux);
+		response += Line(event);
+		return PartResult::Error;
+	}
+	connection.State = ConnectionState::Connecting;
+	connection.Protocol = protocol;
+	connection.Address = address;
+	connection.Port = port;
+	connection.Received.clear();
+	connection.Sent.clear();
+	connection.TxLength = 0;
+
+	snprintf(event, sizeof(event), _connectSucceeds ? "%d, CONNECT OK" : "%d, CONNECT FAIL", mux);
+	Schedule(Line(event), latencyMs + _connectLatencyMs, mux, _connectSucceeds ? ConnectionState::Connected : ConnectionState::Closed);
+	return PartResult::Ok;
+}
+
+ModemSimulator::PartResult ModemSimulator::ExecuteCipSend(const std::string& args, std::string& response)
+{
+	int mux;
+	int length;
+	if (sscanf(args.c_str(), "%d,%d", &mux, &length) != 2 || mux < 0 || mux >= SIMULATOR_MAX_CONNECTIONS || length <= 0)
+	{
+		return PartResult::Error;
+	}
+	if (_connections[mux].State != ConnectionState::Connected)
+	{
+		return PartResult::Error;
+	}
+	_cipsendMux = mux;
+	_cipsendLength = length;
+	_cipsendData.clear();
+	_cipsendLineFeedPending = true;
+	response += "\r\n> ";
+	return PartResult::NoFinalResult;
+}
+
+ModemSimulator::PartResult ModemSimulator::ExecuteCipRxGet(const std::string& args, std::string& response)
+{
+	char buffer[48];
+	int mode;
+	int mux;
+	int length;
+	if (args == "?")
+	{
+		snprintf(buffer, sizeof(buffer), "+CIPRXGET: %d", _rxManual ? 1 : 0);
+		response += Line(buffer);
+		return PartResult::Ok;
+	}
+	const auto fields = sscanf(args.c_str(), "=%d,%d,%d", &mode, &mux, &length);
+	if (fields == 1 && (mode == 0 || mode == 1))
+	{
+		_rxManual = mode == 1;
+		return PartResult::Ok;
+	}
+	if (!_rxManual || fields < 2 || mux < 0 || mux >= SIMULATOR_MAX_CONNECTIONS)
+	{
+		return PartResult::Error;
+	}
+	auto& connection = _connections[mux];
+	if (mode == 4 && fields == 2)
+	{
+		snprintf(buffer, sizeof(buffer), "+CIPRXGET: 4,%d,%u", mux, static_cast<unsigned>(connection.Received.size()));
+		response += Line(buffer);
+		return PartResult::Ok;
+	}
+	if (mode != 2 || fields != 3 || length <= 0)
+	{
+		return PartResult::Error;
+	}
+	const auto readLength = std::min(static_cast<size_t>(std::min(length, SIMULATOR_MAX_RX_READ)), connection.Received.size());
+	const auto data = connection.Received.substr(0, readLength);
+	connection.Received.erase(0, readLength);
+	snprintf(buffer, sizeof(buffer), "+CIPRXGET: 2,%d,%u,%u", mux, static_cast<unsigned>(readLength), static_cast<unsigned>(connection.Received.size()));
+	response += Line(buffer) + data;
+	return PartResult::Ok;
+}
+
+const char* ModemSimulator::ConnectionStateToStr(ConnectionState state)
+{
+	switch (state)
+	{
+	case ConnectionState::Initial: return "INITIAL";
+	case ConnectionState::Connecting: return "CONNECTING";
+	case ConnectionState::Connected: return "CONNECTED";
+	case ConnectionState::Closed: return "CLOSED";
+	}
+	return "";
+}
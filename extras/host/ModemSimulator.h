@@ -0,0 +1,180 @@
+#ifndef _MODEM_SIMULATOR_H
+#define _MODEM_SIMULATOR_H
+
+#include <Stream.h>
+#include "VirtualClock.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+#define SIMULATOR_MAX_CONNECTIONS 6
+#define SIMULATOR_SEND_WINDOW 1460
+
+/*
+Fake SIM800 that can be passed to SimcomAtCommands instead of serial port.
+Commands written to stream are executed immediately, responses become readable
+after command latency and UART transfer time of every byte.
+Modem state (registration, signal, remote side of connections) is set by test code.
+With VirtualClock time passes only when library waits, so long timeouts take no real time
+*/
+class ModemSimulator : public Stream
+{
+public:
+	enum class ConnectionState
+	{
+		Initial,
+		Connecting,
+		Connected,
+		Closed
+	};
+	struct Connection
+	{
+		ConnectionState State;
+		std::string Protocol;
+		std::string Address;
+		int Port;
+		/* data sent by remote side, not yet read by CIPRXGET */
+		std::string Received;
+		/* data accepted by CIPSEND */
+		std::string Sent;
+		/* bytes accepted by CIPSEND since CIPSTART, txlen of AT+CIPACK */
+		size_t TxLength;
+	};
+private:
+	struct OutputByte
+	{
+		uint8_t Value;
+		unsigned long ReadyAt;
+	};
+	struct ScheduledOutput
+	{
+		unsigned long DueAt;
+		std::string Text;
+		/* connection changed when output is sent, -1 if none */
+		int Mux;
+		ConnectionState State;
+	};
+	struct CommandLatency
+	{
+		std::string Prefix;
+		unsigned long LatencyMs;
+	};
+	enum class PartResult
+	{
+		Ok,
+		Error,
+		NoFinalResult
+	};
+
+	VirtualClock *_clock;
+	std::deque<OutputByte> _output;
+	std::vector<ScheduledOutput> _scheduled;
+	std::vector<CommandLatency> _latencies;
+	unsigned long _lastByteReadyAt;
+	std::string _commandLine;
+	uint32_t _randomState;
+
+	int _baudRate;
+	unsigned long _defaultLatencyMs;
+	unsigned long _connectLatencyMs;
+	unsigned long _ussdLatencyMs;
+	double _garbageProbability;
+	double _dropProbability;
+	uint32_t _garbageBytes;
+	uint32_t _droppedBytes;
+
+	bool _echo;
+	std::string _simStatus;
+	int _registrationStatus;
+	int _signalQuality;
+	int _batteryPercent;
+	int _batteryVoltageMv;
+	std::string _operatorName;
+	std::string _operatorNumeric;
+	int _copsFormat;
+	std::string _imei;
+	std::string _ipState;
+	std::string _ipAddress;
+	std::string _ussdResponse;
+	bool _connectSucceeds;
+	bool _cipmux;
+	bool _cipqsend;
+	bool _rxManual;
+	Connection _connections[SIMULATOR_MAX_CONNECTIONS];
+
+	int _cipsendMux;
+	size_t _cipsendLength;
+	std::string _cipsendData;
+	bool _cipsendLineFeedPending;
+	size_t _sendWindow;
+
+	unsigned long Now();
+	double NextRandom();
+	void Pump();
+	void Emit(const std::string& text, unsigned long dueAt);
+	std::string Garbage();
+	void Schedule(const std::string& text, unsigned long delayMs, int mux = -1, ConnectionState state = ConnectionState::Initial);
+	void EchoByte(uint8_t c);
+	unsigned long LatencyFor(const std::string& commandLine);
+	void ExecuteLine(const std::string& line);
+	PartResult ExecutePart(const std::string& part, std::string& response, unsigned long latencyMs);
+	PartResult ExecuteCipStatus(std::string& response);
+	PartResult ExecuteCipStart(const std::string& args, std::string& response, unsigned long latencyMs);
+	PartResult ExecuteCipSend(const std::string& args, std::string& response);
+	PartResult ExecuteCipRxGet(const std::string& args, std::string& response);
+	void CipsendDataReceived(uint8_t c);
+	static const char* ConnectionStateToStr(ConnectionState state);
+public:
+	ModemSimulator(uint32_t seed = 1);
+
+	/* without clock simulator runs in real time */
+	void SetClock(VirtualClock &clock);
+
+	/* UART model, 0 makes bytes available immediately */
+	void SetBaudRate(int baudRate);
+	void SetDefaultLatency(unsigned long latencyMs);
+	/* latency of commands starting with prefix, e.g. "AT+CIICR" */
+	void SetCommandLatency(const char *prefix, unsigned long latencyMs);
+	void SetConnectLatency(unsigned long latencyMs);
+	void SetUssdLatency(unsigned long latencyMs);
+	/* probability that burst of garbage bytes is injected before response */
+	void SetGarbageProbability(double probability);
+	/* probability that single response byte is lost */
+	void SetDropProbability(double probability);
+
+	void SetSimStatus(const char *status);
+	void SetRegistrationStatus(int status);
+	void SetSignalQuality(int rssi);
+	void SetBattery(int percent, int voltageMv);
+	void SetOperator(const char *name, const char *numeric);
+	void SetImei(const char *imei);
+	void SetIpAddress(const char *ipAddress);
+	void SetUssdResponse(const char *response);
+	void SetConnectSucceeds(bool succeeds);
+	/* free space of modem send buffer, longer CIPSEND gets partial DATA ACCEPT */
+	void SetSendWindow(size_t bytes);
+
+	/* remote side of connection */
+	void ReceiveData(uint8_t mux, const char *data, size_t length);
+	void CloseRemote(uint8_t mux);
+	void SendUnsolicited(const char *line);
+	Connection& GetConnection(uint8_t mux);
+
+	uint32_t GarbageBytes() const
+	{
+		return _garbageBytes;
+	}
+	uint32_t DroppedBytes() const
+	{
+		return _droppedBytes;
+	}
+
+	int available() override;
+	int read() override;
+	int peek() override;
+	size_t write(uint8_t c) override;
+	int availableForWrite() override;
+	using Print::write;
+};
+
+#endif
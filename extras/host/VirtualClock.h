@@ -0,0 +1,43 @@
+#ifndef _VIRTUAL_CLOCK_H
+#define _VIRTUAL_CLOCK_H
+
+#include <GsmClock.h>
+#include <stdint.h>
+
+/*
+Simulated time, advances only on Delay() and when library is idle waiting for modem.
+Use the same instance for SimcomAtCommands and ModemSimulator
+*/
+class VirtualClock : public GsmClock
+{
+	uint64_t _nowUs;
+	unsigned long _idleStepUs;
+public:
+	VirtualClock(unsigned long idleStepUs = 100) :
+		_nowUs(0),
+		_idleStepUs(idleStepUs)
+	{
+	}
+	unsigned long Millis() override
+	{
+		return static_cast<unsigned long>(_nowUs / 1000);
+	}
+	unsigned long Micros()
+	{
+		return static_cast<unsigned long>(_nowUs);
+	}
+	void Delay(unsigned long ms) override
+	{
+		Advance(static_cast<uint64_t>(ms) * 1000);
+	}
+	void Idle() override
+	{
+		Advance(_idleStepUs);
+	}
+	void Advance(uint64_t us)
+	{
+		_nowUs += us;
+	}
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef _HOST_ARDUINO_H
+#define _HOST_ARDUINO_H
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pgmspace.h"
+#include "WString.h"
+#include "Stream.h"
+
+#define SERIAL_8N1 0x800001c
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+/* Serial writes to stdout, it never has input */
+class ConsoleStream : public Stream
+{
+public:
+	void begin(unsigned long) { }
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	int available() override { return 0; }
+	int read() override { return -1; }
+	int peek() override { return -1; }
+	void flush() override;
+	using Print::write;
+};
+
+extern ConsoleStream Serial;
+
+#endif
@@ -0,0 +1,147 @@
+#include "Arduino.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+
+ConsoleStream Serial;
+
+static uint64_t MonotonicMicros()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+static const uint64_t StartMicros = MonotonicMicros();
+
+unsigned long millis()
+{
+	return static_cast<unsigned long>((MonotonicMicros() - StartMicros) / 1000);
+}
+
+unsigned long micros()
+{
+	return static_cast<unsigned long>(MonotonicMicros() - StartMicros);
+}
+
+void delay(unsigned long ms)
+{
+	timespec duration;
+	duration.tv_sec = ms / 1000;
+	duration.tv_nsec = (ms % 1000) * 1000000L;
+	nanosleep(&duration, nullptr);
+}
+
+void yield()
+{
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+	size_t n = 0;
+	while (n < size && write(buffer[n]) == 1)
+	{
+		n++;
+	}
+	return n;
+}
+
+size_t Print::print(const __FlashStringHelper *str)
+{
+	return write(reinterpret_cast<const char*>(str));
+}
+
+size_t Print::print(const char *str)
+{
+	return write(str);
+}
+
+size_t Print::print(char c)
+{
+	return write(static_cast<uint8_t>(c));
+}
+
+size_t Print::print(int value)
+{
+	return printf("%d", value);
+}
+
+size_t Print::print(unsigned int value)
+{
+	return printf("%u", value);
+}
+
+size_t Print::print(long value)
+{
+	return printf("%ld", value);
+}
+
+size_t Print::print(unsigned long value)
+{
+	return printf("%lu", value);
+}
+
+size_t Print::print(double value)
+{
+	return printf("%.2f", value);
+}
+
+size_t Print::println()
+{
+	return write("\r\n");
+}
+
+size_t Print::printf(const char *format, ...)
+{
+	char buffer[256];
+	va_list args;
+	va_start(args, format);
+	auto length = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	if (length < 0)
+	{
+		return 0;
+	}
+	if (static_cast<size_t>(length) >= sizeof(buffer))
+	{
+		length = sizeof(buffer) - 1;
+	}
+	return write(reinterpret_cast<const uint8_t*>(buffer), length);
+}
+
+size_t Stream::readBytes(uint8_t *buffer, size_t length)
+{
+	size_t count = 0;
+	auto start = millis();
+	while (count < length)
+	{
+		auto c = read();
+		if (c < 0)
+		{
+			if (millis() - start >= _timeout)
+			{
+				break;
+			}
+			delay(1);
+			continue;
+		}
+		buffer[count++] = static_cast<uint8_t>(c);
+	}
+	return count;
+}
+
+size_t ConsoleStream::write(uint8_t c)
+{
+	return fwrite(&c, 1, 1, stdout);
+}
+
+size_t ConsoleStream::write(const uint8_t *buffer, size_t size)
+{
+	return fwrite(buffer, 1, size, stdout);
+}
+
+void ConsoleStream::flush()
+{
+	fflush(stdout);
+}
@@ -0,0 +1,32 @@
+#ifndef _HOST_IP_ADDRESS_H
+#define _HOST_IP_ADDRESS_H
+
+#include <stdint.h>
+
+/* subset of Arduino IPv4 address */
+class IPAddress
+{
+	uint8_t _address[4];
+public:
+	IPAddress()
+	{
+		_address[0] = _address[1] = _address[2] = _address[3] = 0;
+	}
+	IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth)
+	{
+		_address[0] = first;
+		_address[1] = second;
+		_address[2] = third;
+		_address[3] = fourth;
+	}
+	uint8_t operator[](int index) const
+	{
+		return _address[index];
+	}
+	uint8_t& operator[](int index)
+	{
+		return _address[index];
+	}
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef _HOST_PRINT_H
+#define _HOST_PRINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "WString.h"
+
+/* subset of Arduino Print used by the library and its samples */
+class Print
+{
+public:
+	virtual ~Print() { }
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str)
+	{
+		return str == nullptr ? 0 : write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+	}
+	size_t write(const char *buffer, size_t size)
+	{
+		return write(reinterpret_cast<const uint8_t*>(buffer), size);
+	}
+	virtual int availableForWrite() { return 0; }
+	virtual void flush() { }
+
+	size_t print(const __FlashStringHelper *str);
+	size_t print(const char *str);
+	size_t print(char c);
+	size_t print(int value);
+	size_t print(unsigned int value);
+	size_t print(long value);
+	size_t print(unsigned long value);
+	size_t print(double value);
+
+	size_t println();
+	template<typename T>
+	size_t println(T value)
+	{
+		auto n = print(value);
+		return n + println();
+	}
+
+	size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+#endif
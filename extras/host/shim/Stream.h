@@ -0,0 +1,32 @@
+#ifndef _HOST_STREAM_H
+#define _HOST_STREAM_H
+
+#include "Print.h"
+
+/* subset of Arduino Stream, readBytes waits up to timeout like on target */
+class Stream : public Print
+{
+protected:
+	unsigned long _timeout;
+public:
+	Stream() : _timeout(1000) { }
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+
+	void setTimeout(unsigned long timeout)
+	{
+		_timeout = timeout;
+	}
+	unsigned long getTimeout()
+	{
+		return _timeout;
+	}
+	virtual size_t readBytes(uint8_t *buffer, size_t length);
+	size_t readBytes(char *buffer, size_t length)
+	{
+		return readBytes(reinterpret_cast<uint8_t*>(buffer), length);
+	}
+};
+
+#endif
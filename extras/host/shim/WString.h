@@ -0,0 +1,12 @@
+#ifndef _HOST_WSTRING_H
+#define _HOST_WSTRING_H
+
+#include <ctype.h>
+#include "pgmspace.h"
+
+/* flash strings are ordinary strings on host */
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+#define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper *>(pstr_pointer))
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef _HOST_AVR_PGMSPACE_H
+#define _HOST_AVR_PGMSPACE_H
+
+#include "../pgmspace.h"
+
+#endif
@@ -0,0 +1,59 @@
+/*
+Prints basic modem info, usage: gsm_info [device] [baudrate]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <SimcomAtCommands.h>
+#include <GsmLibHelpers.h>
+#include "FdStream.h"
+
+static FdStream modemSerial;
+
+void UpdateBaudRate(int baudRate)
+{
+	modemSerial.SetBaudRate(baudRate);
+}
+
+void OnLog(const char* gsmLog)
+{
+	printf("[GSM]%s\n", gsmLog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *device = argc > 1 ? argv[1] : "/dev/ttyUSB0";
+	const int baudRate = argc > 2 ? atoi(argv[2]) : 115200;
+
+	if (!modemSerial.Open(device, baudRate))
+	{
+		fprintf(stderr, "Failed to open %s\n", device);
+		return 1;
+	}
+
+	SimcomAtCommands gsm(modemSerial, UpdateBaudRate);
+	gsm.Logger().OnLog(OnLog);
+
+	if (!gsm.EnsureModemConnected(baudRate))
+	{
+		fprintf(stderr, "No modem found on %s\n", device);
+		return 1;
+	}
+
+	ModemStatus status;
+	if (gsm.GetModemStatus(status) != AtResultType::Success)
+	{
+		fprintf(stderr, "Failed to get modem status\n");
+		return 1;
+	}
+	printf("Registration: %s\n", reinterpret_cast<const char*>(RegStatusToStr(status.RegistrationStatus)));
+	printf("Signal quality: %d\n", status.SignalQuality);
+	printf("Battery: %d%% %.2fV\n", status.BatteryInfo.Percent, status.BatteryInfo.Voltage);
+	printf("Operator: %s\n", status.OperatorName.c_str());
+
+	GsmIp ip;
+	if (gsm.GetIpAddress(ip) == AtResultType::Success)
+	{
+		printf("IP: %s\n", ip.ToString().c_str());
+	}
+	return 0;
+}
@@ -0,0 +1,106 @@
+/*
+Runs GsmModule against simulated modem until GPRS is connected, then does TCP round trip.
+Prints simulated duration of each phase, usage: gsm_sim [garbage probability] [drop probability] [trace file]
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <GsmModule.h>
+#include <UartTraceRecorder.h>
+#include "FilePrint.h"
+#include "ModemSimulator.h"
+#include "VirtualClock.h"
+
+static VirtualClock virtualClock;
+static ModemSimulator modem;
+
+void UpdateBaudRate(int baudRate)
+{
+	modem.SetBaudRate(baudRate);
+}
+
+void OnLog(const char* gsmLog)
+{
+	printf("[GSM]%s\n", gsmLog);
+}
+
+int main(int argc, char **argv)
+{
+	const auto wallStart = millis();
+	modem.SetClock(virtualClock);
+	modem.SetGarbageProbability(argc > 1 ? atof(argv[1]) : 0);
+	modem.SetDropProbability(argc > 2 ? atof(argv[2]) : 0);
+	modem.SetCommandLatency("AT+CIICR", 800);
+
+	SimcomAtCommands gsm(modem, UpdateBaudRate);
+	gsm.SetClock(virtualClock);
+	gsm.Logger().OnLog(OnLog);
+	FilePrint traceFile;
+	UartTraceRecorder traceRecorder(traceFile);
+	if (argc > 3)
+	{
+		if (!traceFile.Open(argv[3]))
+		{
+			printf("Failed to open %s\n", argv[3]);
+			return 1;
+		}
+		gsm.SetTraceRecorder(&traceRecorder);
+	}
+	GsmModule gsmModule(gsm);
+
+	auto start = virtualClock.Millis();
+	int loops = 0;
+	while (gsmModule.GetState() != GsmState::ConnectedToGprs && loops < 100)
+	{
+		gsmModule.Loop();
+		loops++;
+	}
+	if (gsmModule.GetState() != GsmState::ConnectedToGprs)
+	{
+		printf("Failed to connect to GPRS\n");
+		return 1;
+	}
+	printf("Connected to GPRS in %lu ms, %d loops\n", virtualClock.Millis() - start, loops);
+
+	start = virtualClock.Millis();
+	if (gsm.BeginConnect(ProtocolType::Tcp, 0, "10.0.0.1", 80) != AtResultType::Success)
+	{
+		printf("CIPSTART failed\n");
+		return 1;
+	}
+	ConnectionInfo connectionInfo;
+	do
+	{
+		gsm.wait(10);
+		gsm.GetConnectionInfo(0, connectionInfo);
+	} while (connectionInfo.State == ConnectionState::Connecting && virtualClock.Millis() - start < 5000);
+	printf("Connect: %s in %lu ms\n", connectionInfo.State == ConnectionState::Connected ? "ok" : "failed", virtualClock.Millis() - start);
+
+	start = virtualClock.Millis();
+	// request line and headers are sent as separate segments of one CIPSEND
+	const char requestLine[] = "GET / HTTP/1.0\r\n";
+	const char headers[] = "Host: 10.0.0.1\r\n\r\n";
+	const SendSegment request[] =
+	{
+		{ reinterpret_cast<const uint8_t*>(requestLine), sizeof(requestLine) - 1 },
+		{ reinterpret_cast<const uint8_t*>(headers), sizeof(headers) - 1 },
+	};
+	uint16_t sentBytes;
+	const auto sendResult = gsm.Send(0, request, 2, sentBytes);
+	printf("Send: %d, %u bytes in %lu ms\n", static_cast<int>(sendResult), sentBytes, virtualClock.Millis() - start);
+
+	const char response[] = "HTTP/1.0 200 OK\r\n\r\nhello";
+	modem.ReceiveData(0, response, sizeof(response) - 1);
+	start = virtualClock.Millis();
+	uint8_t buffer[64];
+	uint16_t readBytes;
+	uint16_t dataLeft;
+	gsm.wait(20);
+	const auto readResult = gsm.Read(0, buffer, sizeof(buffer), readBytes, dataLeft);
+	printf("Read: %d, %u bytes, %u left in %lu ms\n", static_cast<int>(readResult), readBytes, dataLeft, virtualClock.Millis() - start);
+
+	gsm.CloseConnection(0);
+	gsm.LogCommandStats();
+	printf("Garbage bytes: %u, dropped bytes: %u\n", modem.GarbageBytes(), modem.DroppedBytes());
+	printf("Simulated %lu ms in %lu ms\n", virtualClock.Millis(), millis() - wallStart);
+	return 0;
+}
@@ -0,0 +1,374 @@
+/*
+Feeds UART trace recorded by UartTraceRecorder back through SimcomResponseParser
+and reports parse throughput and decode time of each command type.
+Usage: gsm_replay <trace file> [iterations]
+*/
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <GsmLibHelpers.h>
+#include <SimcomResponseParser.h>
+#include <UartTraceRecorder.h>
+
+struct TraceRecord
+{
+	UartTraceDirection Direction;
+	unsigned long Timestamp;
+	size_t Offset;
+	size_t Length;
+};
+
+struct CommandStats
+{
+	uint32_t Count;
+	uint32_t Timeouts;
+	double TotalUs;
+	double MaxUs;
+};
+
+struct CommandPrefix
+{
+	const char *Prefix;
+	AtCommand Command;
+};
+
+// longer prefixes first, first match wins. AT+CIPSTART is sent by library as Generic command
+static const CommandPrefix CommandPrefixes[] =
+{
+	{ "AT+CIPSTATUS=", AtCommand::CipstatusSingleConnection },
+	{ "AT+CIPSTATUS", AtCommand::Cipstatus },
+	{ "AT+CIPRXGET=2", AtCommand::CipRxGetRead },
+	{ "AT+CIPRXGET=4", AtCommand::CipRxGetLength },
+	{ "AT+CIPRXGET?", AtCommand::CipRxGet },
+	{ "AT+CIPQSEND?", AtCommand::CipQsendQuery },
+	{ "AT+CIPSHUT", AtCommand::Cipshut },
+	{ "AT+CIPCLOSE", AtCommand::Cipclose },
+	{ "AT+CIPSEND=", AtCommand::CipSend },
+	{ "AT+CIPSEND?", AtCommand::CipSendQuery },
+	{ "AT+CIPACK", AtCommand::CipAck },
+	{ "AT+CIPMUX?", AtCommand::Cipmux },
+	{ "AT+CIFSR", AtCommand::Cifsr },
+	{ "AT+CPIN?", AtCommand::Cpin },
+	{ "AT+COPS?", AtCommand::Cops },
+	{ "AT+CREG?", AtCommand::Creg },
+	{ "AT+CUSD", AtCommand::Cusd },
+	{ "AT+CLCC", AtCommand::Clcc },
+	{ "AT+CSQ", AtCommand::Csq },
+	{ "AT+CBC", AtCommand::Cbc },
+	{ "AT+GSN", AtCommand::Gsn },
+	{ nullptr, AtCommand::Generic }
+};
+
+static bool FindCommand(const std::string& command, AtCommand& atCommand)
+{
+	for (auto entry = CommandPrefixes; entry->Prefix != nullptr; entry++)
+	{
+		if (command.compare(0, strlen(entry->Prefix), entry->Prefix) == 0)
+		{
+			atCommand = entry->Command;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* AT+CREG?;+CSQ is batch of known commands, AT+CIFSR;E1 is single command */
+static AtCommand ClassifyCommand(const std::string& line, uint32_t& batchCommands)
+{
+	batchCommands = 0;
+	size_t start = 0;
+	int knownCommands = 0;
+	auto firstCommand = AtCommand::Generic;
+	while (start <= line.size())
+	{
+		auto end = line.find(';', start);
+		if (end == std::string::npos)
+		{
+			end = line.size();
+		}
+		auto part = line.substr(start, end - start);
+		if (start > 0)
+		{
+			part = "AT" + part;
+		}
+		AtCommand command;
+		if (FindCommand(part, command))
+		{
+			batchCommands |= BatchCommandBit(command);
+			if (knownCommands++ == 0)
+			{
+				firstCommand = command;
+			}
+		}
+		start = end + 1;
+	}
+	if (knownCommands > 1)
+	{
+		return AtCommand::Batch;
+	}
+	batchCommands = 0;
+	return firstCommand;
+}
+
+/* payload recorded so far padded to length announced in AT+CIPSEND */
+static void FillSendBuffer(uint8_t *sendBuffer, const std::string& payload, size_t length)
+{
+	const auto payloadLength = payload.size() < length ? payload.size() : length;
+	memcpy(sendBuffer, payload.data(), payloadLength);
+	memset(sendBuffer + payloadLength, 'x', length - payloadLength);
+}
+
+static bool ReadVarint(const std::vector<uint8_t>& data, size_t& position, uint32_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35 && position < data.size(); shift += 7)
+	{
+		const auto b = data[position++];
+		value |= static_cast<uint32_t>(b & 0x7F) << shift;
+		if ((b & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool LoadTrace(const char *path, std::vector<uint8_t>& data, std::vector<TraceRecord>& records)
+{
+	auto file = fopen(path, "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	uint8_t buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		data.insert(data.end(), buffer, buffer + n);
+	}
+	fclose(file);
+
+	const auto magicLength = strlen(UART_TRACE_MAGIC);
+	if (data.size() < magicLength + 1 || memcmp(data.data(), UART_TRACE_MAGIC, magicLength) != 0 || data[magicLength] != UART_TRACE_VERSION)
+	{
+		fprintf(stderr, "%s is not UART trace version %d\n", path, UART_TRACE_VERSION);
+		return false;
+	}
+	size_t position = magicLength + 1;
+	unsigned long timestamp = 0;
+	while (position < data.size())
+	{
+		TraceRecord record;
+		record.Direction = static_cast<UartTraceDirection>(data[position++]);
+		uint32_t delta;
+		uint32_t length;
+		if (!ReadVarint(data, position, delta) || !ReadVarint(data, position, length) || position + length > data.size())
+		{
+			fprintf(stderr, "Trace truncated at offset %u\n", static_cast<unsigned>(position));
+			break;
+		}
+		timestamp += delta;
+		record.Timestamp = timestamp;
+		record.Offset = position;
+		record.Length = length;
+		records.push_back(record);
+		position += length;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <trace file> [iterations]\n", argv[0]);
+		return 1;
+	}
+	const int iterations = argc > 2 ? atoi(argv[2]) : 1;
+
+	std::vector<uint8_t> data;
+	std::vector<TraceRecord> records;
+	if (!LoadTrace(argv[1], data, records))
+	{
+		return 1;
+	}
+
+	// every output of parser points to scratch variables
+	int16_t signalQuality;
+	GsmIp ipAddress;
+	FixedString20 operatorName;
+	FixedString150 ussdResponse;
+	FixedString20 imei;
+	BatteryStatus batteryStatus;
+	IncomingCallInfo callInfo;
+	SimcomIpState ipState;
+	ConnectionInfo connectionInfo;
+	FixedString200 rxBuffer;
+	uint8_t rxData[1460];
+	uint8_t sendBuffer[CIPSEND_MAX_LENGTH];
+	uint16_t sentBytes;
+
+	CommandStats stats[AtCommandCount] = {};
+	double totalUs = 0;
+	uint64_t bytesRead = 0;
+	uint64_t bytesWritten = 0;
+	uint64_t lines = 0;
+
+	for (int iteration = 0; iteration < iterations; iteration++)
+	{
+		GsmLogger logger;
+		ParserContext context;
+		context.CsqSignalQuality = &signalQuality;
+		context.IpAddress = &ipAddress;
+		context.OperatorName = &operatorName;
+		context.UssdResponse = &ussdResponse;
+		context.Imei = &imei;
+		context.BatteryInfo = &batteryStatus;
+		context.CallInfo = &callInfo;
+		context.IpState = &ipState;
+		context.CurrentConnectionInfo = &connectionInfo;
+		context.CipRxGetBuffer = &rxBuffer;
+		SendSegment sendSegment;
+		sendSegment.Data = sendBuffer;
+		sendSegment.Length = 0;
+		context.CipsendSegments = &sendSegment;
+		context.CipsendSegmentCount = 1;
+		uint16_t sendWindows[MAX_CONNECTIONS];
+		context.SendWindows = sendWindows;
+		context.CipsendSentBytes = &sentBytes;
+		FixedString200 currentCommandStr;
+		SimcomResponseParser parser(context, logger, currentCommandStr);
+
+		std::string sendPayload;
+		bool commandInProgress = false;
+		auto command = AtCommand::Generic;
+		double commandUs = 0;
+
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			auto& record = records[i];
+			const auto recordData = data.data() + record.Offset;
+			if (record.Direction == UartTraceDirection::Write)
+			{
+				bytesWritten += record.Length;
+				if (command == AtCommand::CipSend && context.CipsendState == CipsendStateType::SendingData)
+				{
+					// payload written by engine after prompt, parser compares echo with it
+					const auto length = context.CipsendLength;
+					sendPayload.append(reinterpret_cast<const char*>(recordData), record.Length);
+					FillSendBuffer(sendBuffer, sendPayload, length);
+					context.CipsendDataWritten = sendPayload.size() < length ? sendPayload.size() : length;
+					if (context.CipsendDataWritten == length)
+					{
+						context.CipsendState = CipsendStateType::WaitingForDataAccept;
+					}
+					continue;
+				}
+				if (record.Length < 2 || recordData[0] != 'A' || recordData[1] != 'T')
+				{
+					continue;
+				}
+				if (commandInProgress)
+				{
+					stats[static_cast<uint8_t>(command)].Timeouts++;
+				}
+				std::string line(reinterpret_cast<const char*>(recordData), record.Length);
+				line = line.substr(0, line.find_first_of("\r\n"));
+				command = ClassifyCommand(line, context.BatchCommands);
+				if (command == AtCommand::CipRxGetRead)
+				{
+					context.CipRxGetData = rxData;
+					context.CipRxGetDataCapacity = sizeof(rxData);
+					context.CipRxGetDataLength = 0;
+				}
+				if (command == AtCommand::CipSend)
+				{
+					int mux = 0;
+					int length = 0;
+					if (sscanf(line.c_str(), "AT+CIPSEND=%d,%d", &mux, &length) != 2 || length <= 0 || length > CIPSEND_MAX_LENGTH)
+					{
+						printf("Unexpected CIPSEND at record %d: %s\n", static_cast<int>(i), line.c_str());
+						length = 0;
+					}
+					sendPayload.clear();
+					FillSendBuffer(sendBuffer, sendPayload, length);
+					sendSegment.Length = length;
+					context.CipsendMux = mux;
+					context.CipsendLength = length;
+					context.CipsendState = CipsendStateType::WaitingForPrompt;
+				}
+				currentCommandStr = line.c_str();
+				// echo state follows ATE commands of recorded session, plain AT is sent without expecting echo
+				parser.SetCommandType(command, context.EchoEnabled && line != "AT");
+				if (line == "ATE0" || line == "ATE1")
+				{
+					context.EchoEnabled = line == "ATE1";
+				}
+				commandInProgress = true;
+				commandUs = 0;
+				continue;
+			}
+
+			size_t position = 0;
+			while (position < record.Length)
+			{
+				const auto start = std::chrono::steady_clock::now();
+				uint8_t *payloadBuffer;
+				auto payloadLength = parser.GetPayloadBuffer(payloadBuffer);
+				size_t fed;
+				if (payloadLength > 0)
+				{
+					fed = payloadLength < record.Length - position ? payloadLength : record.Length - position;
+					memcpy(payloadBuffer, recordData + position, fed);
+					parser.PayloadReceived(fed);
+				}
+				else
+				{
+					fed = parser.FeedChars(recordData + position, record.Length - position);
+				}
+				const double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+				totalUs += elapsedUs;
+				commandUs += elapsedUs;
+				for (size_t j = position; j < position + fed; j++)
+				{
+					lines += recordData[j] == '\n' ? 1 : 0;
+				}
+				bytesRead += fed;
+				position += fed;
+
+				if (commandInProgress && parser.commandReady)
+				{
+					auto& commandStats = stats[static_cast<uint8_t>(command)];
+					commandStats.Count++;
+					commandStats.TotalUs += commandUs;
+					commandStats.MaxUs = commandUs > commandStats.MaxUs ? commandUs : commandStats.MaxUs;
+					commandInProgress = false;
+					context.CipRxGetData = nullptr;
+				}
+			}
+		}
+	}
+
+	printf("Trace: %u records, %llu bytes read, %llu bytes written, %llu lines, %d iteration(s)\n",
+		static_cast<unsigned>(records.size()), static_cast<unsigned long long>(bytesRead / iterations),
+		static_cast<unsigned long long>(bytesWritten / iterations), static_cast<unsigned long long>(lines / iterations), iterations);
+	if (totalUs > 0)
+	{
+		printf("Parse: %.1f us total, %.0f bytes/s, %.0f lines/s\n", totalUs, bytesRead / totalUs * 1e6, lines / totalUs * 1e6);
+	}
+	printf("%-28s %8s %8s %10s %10s\n", "Command", "Count", "Timeouts", "Mean us", "Max us");
+	for (uint8_t i = 0; i < AtCommandCount; i++)
+	{
+		auto& commandStats = stats[i];
+		if (commandStats.Count == 0 && commandStats.Timeouts == 0)
+		{
+			continue;
+		}
+		printf("%-28s %8u %8u %10.2f %10.2f\n", reinterpret_cast<const char*>(AtCommandToStr(static_cast<AtCommand>(i))), commandStats.Count, commandStats.Timeouts,
+			commandStats.Count > 0 ? commandStats.TotalUs / commandStats.Count : 0, commandStats.MaxUs);
+	}
+	return 0;
+}
@@ -0,0 +1,136 @@
+#include "AdaptiveTimeout.h"
+
+AdaptiveTimeout::AdaptiveTimeout()
+{
+	_enabled = true;
+	_floorMs = 100;
+	_ceilingMs = 0;
+	_marginMs = 50;
+	_minSamples = 3;
+	_echoTimeoutMs = 2000;
+	Reset();
+}
+
+void AdaptiveTimeout::Reset()
+{
+	for (auto &estimate : _estimates)
+	{
+		estimate.Key = 0;
+		estimate.Samples = 0;
+		estimate.Backoff = 0;
+		estimate.SmoothedMs = 0;
+		estimate.DeviationMs = 0;
+	}
+	_nextGenericSlot = 0;
+}
+
+/* FNV-1a of command name, 0 marks empty slot */
+uint16_t AdaptiveTimeout::GenericKey(const char *commandStr)
+{
+	uint32_t hash = 2166136261UL;
+	for (auto c = commandStr; *c != '\0' && *c != '=' && *c != '?' && *c != ';'; c++)
+	{
+		hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619UL;
+	}
+	const uint16_t key = static_cast<uint16_t>(hash ^ (hash >> 16));
+	return key == 0 ? 1 : key;
+}
+
+/* transfer time of CIPSEND and CIPRXGET payload grows with its length, latency of short ones says nothing about long ones */
+bool AdaptiveTimeout::IsPayloadSized(AtCommand command)
+{
+	return command == AtCommand::CipSend || command == AtCommand::CipRxGetRead;
+}
+
+AdaptiveTimeout::Estimate* AdaptiveTimeout::Find(AtCommand command, const char *commandStr, bool create)
+{
+	if (IsPayloadSized(command))
+	{
+		return nullptr;
+	}
+	if (command != AtCommand::Generic)
+	{
+		return &_estimates[static_cast<uint8_t>(command)];
+	}
+	const auto key = GenericKey(commandStr);
+	for (uint8_t i = 0; i < ADAPTIVE_TIMEOUT_GENERIC_SLOTS; i++)
+	{
+		auto &estimate = _estimates[AtCommandCount + i];
+		if (estimate.Key == key)
+		{
+			return &estimate;
+		}
+	}
+	if (!create)
+	{
+		return nullptr;
+	}
+	auto &estimate = _estimates[AtCommandCount + _nextGenericSlot];
+	_nextGenericSlot = (_nextGenericSlot + 1) % ADAPTIVE_TIMEOUT_GENERIC_SLOTS;
+	estimate.Key = key;
+	estimate.Samples = 0;
+	estimate.Backoff = 0;
+	return &estimate;
+}
+
+uint32_t AdaptiveTimeout::Timeout(AtCommand command, const char *commandStr, uint32_t ceilingMs)
+{
+	if (!_enabled)
+	{
+		return ceilingMs;
+	}
+	if (_ceilingMs != 0 && ceilingMs > _ceilingMs)
+	{
+		ceilingMs = _ceilingMs;
+	}
+	const auto estimate = Find(command, commandStr, false);
+	if (estimate == nullptr || estimate->Samples < _minSamples)
+	{
+		return ceilingMs;
+	}
+	auto timeoutMs = (estimate->SmoothedMs + 4 * estimate->DeviationMs + _marginMs) << estimate->Backoff;
+	if (timeoutMs < _floorMs)
+	{
+		timeoutMs = _floorMs;
+	}
+	return timeoutMs < ceilingMs ? timeoutMs : ceilingMs;
+}
+
+void AdaptiveTimeout::Record(AtCommand command, const char *commandStr, AtResultType result, uint32_t elapsedMs)
+{
+	auto estimate = Find(command, commandStr, true);
+	if (estimate == nullptr)
+	{
+		return;
+	}
+	if (result == AtResultType::Timeout)
+	{
+		// real latency is unknown, only make next deadline longer
+		if (estimate->Samples > 0 && estimate->Backoff < 4)
+		{
+			estimate->Backoff++;
+		}
+		return;
+	}
+	if (result != AtResultType::Success)
+	{
+		// ERROR often comes right away (e.g. CIICR without network), it isn't latency of successful command
+		return;
+	}
+	if (estimate->Samples == 0)
+	{
+		estimate->SmoothedMs = elapsedMs;
+		estimate->DeviationMs = elapsedMs / 2;
+	}
+	else
+	{
+		const auto deviation = elapsedMs > estimate->SmoothedMs ? elapsedMs - estimate->SmoothedMs : estimate->SmoothedMs - elapsedMs;
+		estimate->DeviationMs = (3 * estimate->DeviationMs + deviation) / 4;
+		estimate->SmoothedMs = (7 * estimate->SmoothedMs + elapsedMs) / 8;
+	}
+	if (estimate->Samples < UINT8_MAX)
+	{
+		estimate->Samples++;
+	}
+	estimate->Backoff = 0;
+}
@@ -0,0 +1,79 @@
+#ifndef _ADAPTIVE_TIMEOUT_H
+#define _ADAPTIVE_TIMEOUT_H
+
+#include <stdint.h>
+#include "SimcomGsmTypes.h"
+
+// Generic commands are told apart by name (text before '=', '?' or ';'), least recently added name is replaced
+const uint8_t ADAPTIVE_TIMEOUT_GENERIC_SLOTS = 8;
+
+/*
+Learns response time of every successful command and derives its timeout from it.
+Smoothed latency and its mean deviation are tracked as in TCP retransmission timer,
+timeout = smoothed + 4 * deviation + margin, which covers high percentile of observed latencies.
+Timeout passed by caller is ceiling, until command has enough samples ceiling is used as is.
+Every timeout doubles next deadline of that command (up to 16x) until it completes again.
+CIPSEND and CIPRXGET read always get their ceiling, their latency depends on payload length.
+*/
+class AdaptiveTimeout
+{
+	struct Estimate
+	{
+		uint16_t Key;
+		uint8_t Samples;
+		uint8_t Backoff;
+		uint32_t SmoothedMs;
+		uint32_t DeviationMs;
+	};
+	Estimate _estimates[AtCommandCount + ADAPTIVE_TIMEOUT_GENERIC_SLOTS];
+	uint8_t _nextGenericSlot;
+	bool _enabled;
+	uint32_t _floorMs;
+	uint32_t _ceilingMs;
+	uint32_t _marginMs;
+	uint8_t _minSamples;
+	uint32_t _echoTimeoutMs;
+
+	Estimate* Find(AtCommand command, const char *commandStr, bool create);
+	static bool IsPayloadSized(AtCommand command);
+	static uint16_t GenericKey(const char *commandStr);
+public:
+	AdaptiveTimeout();
+	/* disabled policy always returns ceiling */
+	void SetEnabled(bool enabled)
+	{
+		_enabled = enabled;
+	}
+	/* learned timeout is never shorter than floor */
+	void SetFloor(uint32_t floorMs)
+	{
+		_floorMs = floorMs;
+	}
+	/* caps timeout of every command, 0 leaves only ceiling given by caller */
+	void SetCeiling(uint32_t ceilingMs)
+	{
+		_ceilingMs = ceilingMs;
+	}
+	void SetMargin(uint32_t marginMs)
+	{
+		_marginMs = marginMs;
+	}
+	void SetMinSamples(uint8_t minSamples)
+	{
+		_minSamples = minSamples;
+	}
+	/* modem that doesn't echo command within this time is considered hung, 0 disables check */
+	void SetEchoTimeout(uint32_t echoTimeoutMs)
+	{
+		_echoTimeoutMs = echoTimeoutMs;
+	}
+	uint32_t EchoTimeout() const
+	{
+		return _echoTimeoutMs;
+	}
+	uint32_t Timeout(AtCommand command, const char *commandStr, uint32_t ceilingMs);
+	void Record(AtCommand command, const char *commandStr, AtResultType result, uint32_t elapsedMs);
+	void Reset();
+};
+
+#endif
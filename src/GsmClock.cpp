@@ -0,0 +1,3 @@
+#include "GsmClock.h"
+
+ArduinoClock ArduinoClock::Instance;
@@ -0,0 +1,37 @@
+#ifndef _GSM_CLOCK_H
+#define _GSM_CLOCK_H
+
+#include <Arduino.h>
+
+/*
+Time source used for command timeouts and delays, 
+host builds replace it with virtual clock so timeouts run in simulated time
+*/
+class GsmClock
+{
+public:
+	virtual unsigned long Millis() = 0;
+	virtual void Delay(unsigned long ms) = 0;
+	/* called from blocking loops while waiting for modem response */
+	virtual void Idle() = 0;
+};
+
+class ArduinoClock : public GsmClock
+{
+public:
+	static ArduinoClock Instance;
+	unsigned long Millis() override
+	{
+		return millis();
+	}
+	void Delay(unsigned long ms) override
+	{
+		delay(ms);
+	}
+	void Idle() override
+	{
+		yield();
+	}
+};
+
+#endif
@@ -2,6 +2,34 @@
 #define _GSMLIBCONSTANTS_H
 
 const int AT_DEFAULT_TIMEOUT = 1500;
+const int ASYNC_COMMAND_QUEUE_SIZE = 4;
+const int SERIAL_READ_BUFFER_SIZE = 64;
+// written at once when serial port doesn't report free space of its TX buffer
+const int SERIAL_WRITE_CHUNK_SIZE = 64;
+// URCs parsed while command is in progress, their handlers run when engine is idle
+const int UNSOLICITED_QUEUE_SIZE = 4;
+// connections in AT+CIPMUX=1 mode
+const int MAX_CONNECTIONS = 6;
+// assumed for payload transfer time until EnsureModemConnected finds baud rate
+const long UNKNOWN_BAUD_RATE = 9600;
+// largest payload of single AT+CIPSEND
+const int CIPSEND_MAX_LENGTH = 1460;
+// CONNECT OK/CONNECT FAIL of CIPSTART in multi connection mode is expected within this time
+const int CONNECT_TIMEOUT = 75000;
+// largest data block of single AT+CIPRXGET=2
+const int CIPRXGET_MAX_LENGTH = 1460;
+// SendAsync() buffers submitted and not yet accepted by modem
+const int SEND_QUEUE_SIZE = 4;
+// SendAll() gives up after this many CIPSENDs in a row with nothing accepted
+const int SEND_ALL_MAX_RETRIES = 5;
+const int SEND_ALL_RETRY_DELAY = 200;
+// S900Socket ring buffers, every socket object has its own pair
+const int SOCKET_RX_BUFFER_SIZE = 512;
+const int SOCKET_TX_BUFFER_SIZE = 512;
+// sockets read when +CIPRXGET: 1,<mux> arrives, without it modem is asked this often in case notification was lost
+const int SOCKET_POLL_INTERVAL = 5000;
+// write() and flush() give up when modem doesn't accept data for this long
+const int SOCKET_WRITE_TIMEOUT = 10000;
 
 const int _defaultBaudRates[] =
 {
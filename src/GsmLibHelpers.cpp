@@ -61,6 +61,38 @@ const __FlashStringHelper* ConnectionStateToStr(ConnectionState state)
 	}
 }
 
+const __FlashStringHelper* AtCommandToStr(AtCommand command)
+{
+	switch (command)
+	{
+	case AtCommand::Generic: return F("Generic");
+	case AtCommand::Cpin: return F("Cpin");
+	case AtCommand::Cipstatus: return F("Cipstatus");
+	case AtCommand::CipstatusSingleConnection: return F("CipstatusSingleConnection");
+	case AtCommand::Csq: return F("Csq");
+	case AtCommand::Cifsr: return F("Cifsr");
+	case AtCommand::Cipstart: return F("Cipstart");
+	case AtCommand::Cops: return F("Cops");
+	case AtCommand::Creg: return F("Creg");
+	case AtCommand::Gsn: return F("Gsn");
+	case AtCommand::Cipshut: return F("Cipshut");
+	case AtCommand::Cipclose: return F("Cipclose");
+	case AtCommand::Cusd: return F("Cusd");
+	case AtCommand::Cbc: return F("Cbc");
+	case AtCommand::Clcc: return F("Clcc");
+	case AtCommand::Cipmux: return F("Cipmux");
+	case AtCommand::CipRxGet: return F("CipRxGet");
+	case AtCommand::CipRxGetRead: return F("CipRxGetRead");
+	case AtCommand::CipQsendQuery: return F("CipQsendQuery");
+	case AtCommand::CipSend: return F("CipSend");
+	case AtCommand::CipSendQuery: return F("CipSendQuery");
+	case AtCommand::CipRxGetLength: return F("CipRxGetLength");
+	case AtCommand::CipAck: return F("CipAck");
+	case AtCommand::Batch: return F("Batch");
+	default: return F("Unknown");
+	}
+}
+
 void BinaryToString(FixedStringBase&source, FixedStringBase& target)
 {
 	for (int i = 0; i < source.length(); i++)
@@ -8,6 +8,7 @@ const __FlashStringHelper* IpStatusToStr(SimcomIpState ipStatus);
 const __FlashStringHelper* RegStatusToStr(GsmRegistrationState state);
 const __FlashStringHelper* ProtocolToStr(ProtocolType protocol);
 const __FlashStringHelper* ConnectionStateToStr(ConnectionState state);
+const __FlashStringHelper* AtCommandToStr(AtCommand command);
 void BinaryToString(FixedStringBase&source, FixedStringBase& target);
 
 #endif
\ No newline at end of file
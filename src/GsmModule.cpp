@@ -11,11 +11,49 @@ GsmModule::GsmModule(SimcomAtCommands &gsm):
 
 bool GsmModule::GetVariablesFromModem()
 {
-	if (_gsm.GetRegistrationStatus(gsmRegStatus) == AtResultType::Timeout)
+	ModemStatus modemStatus;
+	const auto statusResult = _gsm.GetModemStatus(modemStatus);
+	if (statusResult == AtResultType::Timeout)
+	{
+		return false;
+	}
+	if (statusResult != AtResultType::Success)
+	{
+		// one of batched commands isn't supported by modem
+		if (!GetVariablesOneByOne())
+		{
+			return false;
+		}
+	}
+	else
+	{
+		gsmRegStatus = modemStatus.RegistrationStatus;
+		signalQuality = modemStatus.SignalQuality;
+		batteryInfo = modemStatus.BatteryInfo;
+		callInfo = modemStatus.CallInfo;
+		if (modemStatus.IsOperatorNameReturnedInImsiFormat)
+		{
+			OperatorNameHelper::ResolveOperatorName(modemStatus.OperatorName, operatorName);
+		}
+		// switches operator name format to IMSI, next batch will return it in that format
+		else if (OperatorNameHelper::GetRealOperatorName(_gsm, operatorName) == AtResultType::Timeout)
+		{
+			return false;
+		}
+	}
+	if (_gsm.GetIpState(ipStatus) == AtResultType::Timeout)
 	{
 		return false;
 	}
+	return true;
+}
 
+bool GsmModule::GetVariablesOneByOne()
+{
+	if (_gsm.GetRegistrationStatus(gsmRegStatus) == AtResultType::Timeout)
+	{
+		return false;
+	}
 	if (_gsm.GetSignalQuality(signalQuality) == AtResultType::Timeout)
 	{
 		return false;
@@ -32,10 +70,6 @@ bool GsmModule::GetVariablesFromModem()
 	{
 		return false;
 	}
-	if (_gsm.GetIpState(ipStatus) == AtResultType::Timeout)
-	{
-		return false;
-	}
 	return true;
 }
 
@@ -50,7 +84,7 @@ void GsmModule::Loop()
 	{
 		if (!_gsm.EnsureModemConnected(460800))
 		{
-			delay(500);
+			_gsm.Clock().Delay(500);
 			return;
 		}
 		ChangeState(GsmState::Initializing);
@@ -162,7 +196,7 @@ void GsmModule::Loop()
 		if (simStatus != SimState::Ok)
 		{
 			ChangeState(GsmState::SimError);
-			delay(500);
+			_gsm.Clock().Delay(500);
 			return;
 		}
 	}
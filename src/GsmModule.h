@@ -34,6 +34,7 @@ class GsmModule
 	}
 	GsmState _state;
 	bool GetVariablesFromModem();
+	bool GetVariablesOneByOne();
 public:
 	GsmState GetState()
 	{
@@ -17,16 +17,21 @@ AtResultType OperatorNameHelper::GetRealOperatorName(SimcomAtCommands& gsm, Fixe
 	{
 		return result;
 	}
-	auto realName = GetRealNetworkName(netowrkNameImsi.c_str());
+	ResolveOperatorName(netowrkNameImsi, operatorName);
+	return result;
+}
+
+void OperatorNameHelper::ResolveOperatorName(FixedString20& networkNameImsi, FixedString20& operatorName)
+{
+	auto realName = GetRealNetworkName(networkNameImsi.c_str());
 	if (realName != nullptr)
 	{
 		operatorName = realName;
 	}
 	else
 	{
-		operatorName = netowrkNameImsi;
+		operatorName = networkNameImsi;
 	}
-	return result;
 }
 
 const char* OperatorNameHelper::GetRealNetworkName(const char* networkName)
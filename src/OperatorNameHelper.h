@@ -11,6 +11,7 @@ class OperatorNameHelper
 	static const char *GetRealNetworkName(const char* networkName);
 public:
 	static AtResultType GetRealOperatorName(SimcomAtCommands& gsm, FixedString20&operatorName);
+	static void ResolveOperatorName(FixedString20& networkNameImsi, FixedString20& operatorName);
 };
 
 
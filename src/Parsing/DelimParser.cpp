@@ -1,8 +1,25 @@
 #include "DelimParser.h"
 
 
+bool TokenView::Equals(const __FlashStringHelper* str) const
+{
+	auto p = reinterpret_cast<PGM_P>(str);
+	return strlen_P(p) == Length && strncmp_P(Data, p, Length) == 0;
+}
+
 DelimParser::DelimParser(FixedStringBase &line, char separator):
-	_line(line),
+	_line(line.c_str()),
+	_length(line.length()),
+	_separator(separator)
+{
+	_position = 0;
+	_tokenStart = 0;
+	_currentState = LineParserState::Initial;
+}
+
+DelimParser::DelimParser(const TokenView &line, char separator) :
+	_line(line.Data),
+	_length(line.Length),
 	_separator(separator)
 {
 	_position = 0;
@@ -12,11 +29,12 @@ DelimParser::DelimParser(FixedStringBase &line, char separator):
 
 bool DelimParser::StartsWith(const __FlashStringHelper* commandStart)
 {
-	if (!_line.startsWith(commandStart))
+	auto prefixLength = strlen_P((PGM_P)commandStart);
+	if (prefixLength > _length || strncmp_P(_line, (PGM_P)commandStart, prefixLength) != 0)
 	{
 		return false;
 	}
-	_position = strlen_P((PGM_P)commandStart);
+	_position = prefixLength;
 	_tokenStart = _position;
 
 	_currentState = LineParserState::Initial;
@@ -88,16 +106,16 @@ LineParserState DelimParser::GetNextState(char c, LineParserState state)
 
 bool DelimParser::NextToken()
 {
-	while (_position <= _line.length() && (_currentState != LineParserState::Error))
+	while (_position <= _length && (_currentState != LineParserState::Error))
 	{
 		auto previousState = _currentState;
-		if (_position == _line.length())
+		if (_position == _length)
 		{
 			_currentState = LineParserState::END;
 		}
 		else
 		{
-			auto c = _line.c_str()[_position];
+			auto c = _line[_position];
 			_currentState = GetNextState(c, _currentState);
 		}
 		//printf("state %s -> %s\n", StateToStr(previousState), StateToStr(_currentState));
@@ -142,19 +160,29 @@ bool DelimParser::NextToken()
 	return false;
 }
 
-FixedString150 DelimParser::CurrentToken()
+bool DelimParser::NextToken(TokenView& token)
 {
-	FixedString150 str;
-	auto tokEnd = _position - 1;
-	if (_tokenStart <= tokEnd)
+	if (!NextToken())
 	{
-		str.append(_line.c_str() + _tokenStart, tokEnd - _tokenStart);
+		return false;
 	}
-	else
+	token = CurrentToken();
+	return true;
+}
+
+bool DelimParser::HasMoreTokens()
+{
+	return _position < _length && _currentState != LineParserState::Error;
+}
+
+TokenView DelimParser::CurrentToken()
+{
+	auto tokEnd = _position - 1;
+	if (_position == 0 || _tokenStart > tokEnd)
 	{
-		str = "[invalid]";
+		return TokenView(_line + _position, 0);
 	}
-	return str;
+	return TokenView(_line + _tokenStart, tokEnd - _tokenStart);
 }
 
 bool DelimParser::Skip(int tokenCount)
@@ -170,69 +198,125 @@ bool DelimParser::Skip(int tokenCount)
 }
 bool DelimParser::NextString(FixedStringBase& targetString)
 {
-	if (!NextToken())
+	TokenView token;
+	if (!NextToken(token))
 	{
 		return false;
 	}
-	int tokLength = _position - 1 - _tokenStart;
 	targetString.clear();
-	targetString.append(_line.c_str() + _tokenStart, tokLength);
+	targetString.append(token.Data, token.Length);
 	return true;
 }
 
 bool DelimParser::NextNum(uint8_t& dst, bool allowNull, int base)
 {
-	uint16_t num;
-	if (NextNum(num, allowNull, base))
+	uint32_t num;
+	if (!NextNum(num, allowNull, base) || num > UINT8_MAX)
 	{
-		dst = num;
-		return true;
+		return false;
 	}
-	return false;
+	dst = num;
+	return true;
 }
 
 bool DelimParser::NextNum(int16_t& dst, bool allowNull, int base)
 {
-	uint16_t num;
-	if (NextNum(num, allowNull, base))
+	int32_t num;
+	if (!NextNum(num, allowNull, base) || num < INT16_MIN || num > INT16_MAX)
 	{
-		dst = num;
-		return true;
+		return false;
 	}
-	return false;
+	dst = num;
+	return true;
 }
+
 bool DelimParser::NextNum(uint16_t &dst, bool allowNull, int base)
 {
-	if (!NextToken())
+	uint32_t num;
+	if (!NextNum(num, allowNull, base) || num > UINT16_MAX)
 	{
 		return false;
 	}
+	dst = num;
+	return true;
+}
 
-	auto tokenEnd = _position - 1;
-
-	if (allowNull && _tokenStart == tokenEnd)
+bool DelimParser::NextNum(int32_t& dst, bool allowNull, int base)
+{
+	TokenView token;
+	if (!NextToken(token))
+	{
+		return false;
+	}
+	if (allowNull && token.Length == 0)
 	{
 		dst = 0;
 		return true;
 	}
+	return ParseNum(token, dst, base);
+}
 
-	dst = 0;
+bool DelimParser::NextNum(uint32_t& dst, bool allowNull, int base)
+{
+	TokenView token;
+	if (!NextToken(token))
+	{
+		return false;
+	}
+	if (allowNull && token.Length == 0)
+	{
+		dst = 0;
+		return true;
+	}
+	return ParseNum(token, dst, base);
+}
 
-	int x = 1;
-	int i = tokenEnd;
-	do
+bool DelimParser::ParseNum(const TokenView& token, uint32_t& dst, int base)
+{
+	if (token.Length == 0)
 	{
-		char c = _line.c_str()[i - 1];
-		int digitNum = hexDigitToInt(c);
-		if (digitNum == -1)
+		return false;
+	}
+	uint32_t value = 0;
+	for (uint8_t i = 0; i < token.Length; i++)
+	{
+		int digitNum = hexDigitToInt(token.Data[i]);
+		if (digitNum == -1 || digitNum >= base)
 		{
 			return false;
 		}
+		if (value > (UINT32_MAX - digitNum) / base)
+		{
+			return false;
+		}
+		value = value * base + digitNum;
+	}
+	dst = value;
+	return true;
+}
 
-		dst += x * digitNum;
-		x *= base;
-	} while (--i > _tokenStart);
-
+bool DelimParser::ParseNum(const TokenView& token, int32_t& dst, int base)
+{
+	bool negative = token.Length > 0 && token.Data[0] == '-';
+	uint32_t magnitude;
+	if (!ParseNum(negative ? TokenView(token.Data + 1, token.Length - 1) : token, magnitude, base))
+	{
+		return false;
+	}
+	if (negative)
+	{
+		if (magnitude > static_cast<uint32_t>(INT32_MAX) + 1)
+		{
+			return false;
+		}
+		dst = static_cast<int32_t>(0 - magnitude);
+		return true;
+	}
+	if (magnitude > INT32_MAX)
+	{
+		return false;
+	}
+	dst = magnitude;
 	return true;
 }
 
@@ -18,26 +18,48 @@ enum class LineParserState
 	END
 };
 
+/* token of parsed line, points directly into line buffer and is not null terminated */
+struct TokenView
+{
+	const char *Data;
+	uint8_t Length;
+	TokenView() : Data(nullptr), Length(0) { }
+	TokenView(const char *data, uint8_t length) : Data(data), Length(length) { }
+	bool Equals(const __FlashStringHelper* str) const;
+	bool operator==(const __FlashStringHelper* str) const { return Equals(str); }
+	bool operator!=(const __FlashStringHelper* str) const { return !Equals(str); }
+};
+
 class DelimParser
 {
-	FixedStringBase &_line;
+	const char *_line;
+	uint8_t _length;
 	uint8_t _position;
 	LineParserState _currentState;
 	uint8_t _tokenStart;
 	LineParserState GetNextState(char c, LineParserState state);
-	int hexDigitToInt(char c);
+	static int hexDigitToInt(char c);
 	char _separator;
 public:
 	void SetSeparator(char separator);
 	bool StartsWith(const __FlashStringHelper* commandStart);
 	DelimParser(FixedStringBase &line, char separator = ',');
+	DelimParser(const TokenView &line, char separator = ',');
 	bool NextToken();
-	FixedString150 CurrentToken();
+	bool NextToken(TokenView& token);
+	bool HasMoreTokens();
+	TokenView CurrentToken();
 	bool Skip(int tokenCount);
 	bool NextString(FixedStringBase& targetString);
 	bool NextNum(uint8_t & dst, bool allowNull = false, int base = 10);
 	bool NextNum(int16_t& dst, bool allowNull = false, int base = 10);
 	bool NextNum(uint16_t& dst, bool allowNull = false, int base = 10);
+	bool NextNum(int32_t& dst, bool allowNull = false, int base = 10);
+	bool NextNum(uint32_t& dst, bool allowNull = false, int base = 10);
+
+	/* converts token in place, fails on invalid digit or when value does not fit */
+	static bool ParseNum(const TokenView& token, uint32_t& dst, int base = 10);
+	static bool ParseNum(const TokenView& token, int32_t& dst, int base = 10);
 
 	static const  __FlashStringHelper* StateToStr(LineParserState state);
 };
@@ -8,8 +8,24 @@ struct ParserContext
 	ParserContext()
 	{
 		Cipmux = false;
+		EchoEnabled = true;
 		IsOperatorNameReturnedInImsiFormat = false;
 		IsRxManual = false;
+		BatchCommands = 0;
+		CiprxGetLeftBytesToRead = 0;
+		CipRxGetData = nullptr;
+		CipRxGetDataCapacity = 0;
+		CipRxGetDataLength = 0;
+		CipRxGetDataLeft = 0;
+		RxDataPending = 0;
+		Connections = nullptr;
+		CipsendDataWritten = 0;
+		CipsendEchoReceived = 0;
+		CipsendSegments = nullptr;
+		CipsendSegmentCount = 0;
+		CipsendMux = 0;
+		CipsendLength = 0;
+		CipAckTxLength = nullptr;
 	}
 	int16_t* CsqSignalQuality;
 	GsmIp* IpAddress;
@@ -22,17 +38,43 @@ struct ParserContext
 	SimcomIpState* IpState;	
 	bool IsOperatorNameReturnedInImsiFormat;
 	bool Cipmux;
+	// ATE1, modem repeats commands and CIPSEND payload
+	bool EchoEnabled;
 	ConnectionInfo* CurrentConnectionInfo;
+	// MAX_CONNECTIONS entries filled from C: lines of AT+CIPSTATUS, not filled when null
+	ConnectionInfo* Connections;
 	GsmRegistrationState RegistrationStatus;
 	SimState SimStatus;
 	bool IsRxManual;
 	FixedStringBase* CipRxGetBuffer;
 	uint16_t CiprxGetLeftBytesToRead;
+	// binary AT+CIPRXGET=2 target, used instead of CipRxGetBuffer when not null
+	uint8_t* CipRxGetData;
+	uint16_t CipRxGetDataCapacity;
+	uint16_t CipRxGetDataLength;
+	uint16_t CipRxGetDataLeft;
+	// bit per mux, set by +CIPRXGET: 1,<mux> and kept until read leaves nothing in modem
+	uint8_t RxDataPending;
 	bool CipQSend;
 
 	CipsendStateType CipsendState;
-	FixedStringBase* CipsendBuffer;
+	const SendSegment* CipsendSegments;
+	uint8_t CipsendSegmentCount;
+	// <n>, SEND OK of this mux completes CIPSEND
+	uint8_t CipsendMux;
+	// total length of segments
+	uint16_t CipsendLength;
 	uint16_t *CipsendSentBytes;
+	// payload bytes written after prompt and their echo consumed by parser
+	uint16_t CipsendDataWritten;
+	uint16_t CipsendEchoReceived;
+	// AT+CIPSEND? result, free space of every connection
+	uint16_t* SendWindows;
+	// AT+CIPACK result, bytes modem took for sending since connection was started
+	uint32_t* CipAckTxLength;
+
+	// mask of BatchCommandBit() values of commands concatenated in AtCommand::Batch line
+	uint32_t BatchCommands;
 };
 
 #endif
@@ -47,6 +47,11 @@ bool ParsingHelpers::IsImeiValid(FixedStringBase &imei)
 	return true;
 }
 bool ParsingHelpers::ParseIpAddress(FixedStringBase &ipAddress, GsmIp& ip)
+{
+	return ParseIpAddress(TokenView(ipAddress.c_str(), ipAddress.length()), ip);
+}
+
+bool ParsingHelpers::ParseIpAddress(const TokenView& ipAddress, GsmIp& ip)
 {
 	DelimParser parser(ipAddress, '.');
 	uint8_t octet;
@@ -60,7 +65,7 @@ bool ParsingHelpers::ParseIpAddress(FixedStringBase &ipAddress, GsmIp& ip)
 	return n == 4;
 }
 
-bool ParsingHelpers::ParseProtocolType(FixedString20& protocolStr, ProtocolType& protocol)
+bool ParsingHelpers::ParseProtocolType(const TokenView& protocolStr, ProtocolType& protocol)
 {
 	if (protocolStr == F("TCP"))
 	{
@@ -69,13 +74,13 @@ bool ParsingHelpers::ParseProtocolType(FixedString20& protocolStr, ProtocolType&
 	}
 	if (protocolStr == F("UDP"))
 	{
-		protocol = ProtocolType::Tcp;
+		protocol = ProtocolType::Udp;
 		return true;
 	}
 	return false;
 }
 
-bool ParsingHelpers::ParseConnectionState(FixedString20& connectionStateStr, ConnectionState& connectionState)
+bool ParsingHelpers::ParseConnectionState(const TokenView& connectionStateStr, ConnectionState& connectionState)
 {
 	if (connectionStateStr == F("INITIAL"))
 	{
@@ -110,6 +115,31 @@ bool ParsingHelpers::ParseConnectionState(FixedString20& connectionStateStr, Con
 	return false;
 }
 
+/* parses event of multi connection line: <n>, <event> */
+bool ParsingHelpers::ParseConnectionEvent(const TokenView& eventStr, UnsolicitedType& eventType)
+{
+	if (eventStr == F("CONNECT OK"))
+	{
+		eventType = UnsolicitedType::ConnectOk;
+		return true;
+	}
+	if (eventStr == F("CONNECT FAIL"))
+	{
+		eventType = UnsolicitedType::ConnectFail;
+		return true;
+	}
+	if (eventStr == F("ALREADY CONNECT"))
+	{
+		eventType = UnsolicitedType::AlreadyConnected;
+		return true;
+	}
+	if (eventStr == F("CLOSED"))
+	{
+		eventType = UnsolicitedType::ConnectionClosed;
+		return true;
+	}
+	return false;
+}
 
 struct IpStatusEntry
 {
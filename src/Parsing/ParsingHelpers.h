@@ -3,6 +3,7 @@
 
 #include <FixedString.h>
 #include "SimcomGsmTypes.h"
+#include "DelimParser.h"
 
 class ParsingHelpers
 {
@@ -10,9 +11,11 @@ public:
 	static bool ParseRegistrationStatus(uint16_t status, GsmRegistrationState& gsmStatus);
 	static bool IsImeiValid(FixedStringBase &imei);
 	static bool ParseIpAddress(FixedStringBase &ipAddress, GsmIp& ip);
-	static bool ParseProtocolType(FixedString20& protocolStr, ProtocolType& protocol);
-	static bool ParseConnectionState(FixedString20& connectionStateStr, ConnectionState& connectionState);
+	static bool ParseIpAddress(const TokenView& ipAddress, GsmIp& ip);
+	static bool ParseProtocolType(const TokenView& protocolStr, ProtocolType& protocol);
+	static bool ParseConnectionState(const TokenView& connectionStateStr, ConnectionState& connectionState);
 	static bool ParseIpStatus(const char *str, SimcomIpState &status);
+	static bool ParseConnectionEvent(const TokenView& eventStr, UnsolicitedType& eventType);
 	static bool CheckIfLineContainsGarbage(FixedStringBase &line);
 };
 
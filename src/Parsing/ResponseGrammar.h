@@ -0,0 +1,96 @@
+#ifndef _RESPONSE_GRAMMAR_H
+#define _RESPONSE_GRAMMAR_H
+
+#include "DelimParser.h"
+
+/*
+Compile time description of +XXX: a,b,"c" response lines. 
+Fields are parsed in single pass of DelimParser directly into members of target struct, e.g:
+
+typedef ResponseGrammar<CsqResponse,
+	NumField<CsqResponse, uint8_t, &CsqResponse::Rssi>,
+	NumField<CsqResponse, uint8_t, &CsqResponse::Ber>> CsqGrammar;
+
+Line prefix is not part of grammar, parser must be positioned after it
+*/
+template<typename T, typename... Fields>
+struct ResponseGrammar;
+
+template<typename T>
+struct ResponseGrammar<T>
+{
+	static bool Parse(DelimParser&, T&)
+	{
+		return true;
+	}
+};
+
+template<typename T, typename Field, typename... Rest>
+struct ResponseGrammar<T, Field, Rest...>
+{
+	static bool Parse(DelimParser& parser, T& target)
+	{
+		return Field::Parse(parser, target) && ResponseGrammar<T, Rest...>::Parse(parser, target);
+	}
+};
+
+/* numeric field, empty token is parsed as 0 when AllowNull is set */
+template<typename T, typename TField, TField T::*Member, bool AllowNull = false>
+struct NumField
+{
+	static bool Parse(DelimParser& parser, T& target)
+	{
+		return parser.NextNum(target.*Member, AllowNull);
+	}
+};
+
+/* string field, quotes are removed. Member can be FixedString, pointer to one or TokenView into parsed line */
+template<typename T, typename TString, TString T::*Member>
+struct StrField
+{
+	static bool Parse(DelimParser& parser, T& target)
+	{
+		return NextString(parser, target.*Member);
+	}
+private:
+	static bool NextString(DelimParser& parser, FixedStringBase& str)
+	{
+		return parser.NextString(str);
+	}
+	static bool NextString(DelimParser& parser, FixedStringBase* str)
+	{
+		return parser.NextString(*str);
+	}
+	static bool NextString(DelimParser& parser, TokenView& token)
+	{
+		return parser.NextToken(token);
+	}
+};
+
+/* skips fields that are not needed */
+template<int Count>
+struct SkipFields
+{
+	template<typename T>
+	static bool Parse(DelimParser& parser, T&)
+	{
+		return parser.Skip(Count);
+	}
+};
+
+/* trailing fields that modem omits in some states, e.g. +COPS: 0 */
+template<typename... Fields>
+struct OptionalFields
+{
+	template<typename T>
+	static bool Parse(DelimParser& parser, T& target)
+	{
+		if (!parser.HasMoreTokens())
+		{
+			return true;
+		}
+		return ResponseGrammar<T, Fields...>::Parse(parser, target);
+	}
+};
+
+#endif
@@ -2,19 +2,30 @@
 
 #include "GsmLibHelpers.h"
 #include "ParsingHelpers.h"
+#include "ResponseGrammar.h"
 
-SimcomResponseParser::SimcomResponseParser(ParserContext& parserContext, GsmLogger& logger, Stream& serial, FixedStringBase &currentCommandStr):
+SimcomResponseParser::SimcomResponseParser(ParserContext& parserContext, GsmLogger& logger, FixedStringBase &currentCommandStr):
 _logger(logger),
 _parserContext(parserContext),
 _dataReceivedCallback(nullptr),
+_connectionEventCallback(nullptr),
+_connectionEventCallbackState(nullptr),
+_unsolicitedQueueHead(0),
+_unsolicitedQueueCount(0),
 _garbageOnSerialDetected(false),
-_serial(serial),
+_staleResponse(false),
+_cipstatusLines(0),
 _promptSequenceDetector("> "),
 commandReady(false),
 _currentCommandStr(currentCommandStr)
 {
 	_currentCommand = AtCommand::Generic;
 	lineParserState = PARSER_INITIAL;
+	for (uint8_t i = 0; i < UnsolicitedTypeCount; i++)
+	{
+		_unsolicitedCallbacks[i] = nullptr;
+		_unsolicitedCallbackStates[i] = nullptr;
+	}
 	_state = ParserState::Timeout;
 }
 
@@ -40,35 +51,30 @@ AtResultType SimcomResponseParser::GetAtResultType()
 /* processes character read from serial port of gsm module */
 void SimcomResponseParser::FeedChar(char c)
 {	
-	if (_state != ParserState::WaitingForEcho)
+	if (IsWaitingForPrompt())
 	{
-		if (_currentCommand == AtCommand::CipSend &&
-			_parserContext.CipsendState == CipsendStateType::WaitingForPrompt)
+		if (_promptSequenceDetector.NextChar(c))
 		{
-			if (_promptSequenceDetector.NextChar(c))
+			// command engine writes payload as UART has space for it
+			if (_state == ParserState::WaitingForEcho)
 			{
-				_parserContext.CipsendState = CipsendStateType::WaitingForDataAccept;
-				_response.clear();
-				_serial.write(_parserContext.CipsendBuffer->c_str(), _parserContext.CipsendBuffer->length());
-
-				int readBytes = 0;
-				while (readBytes < _parserContext.CipsendBuffer->length())
-				{
-					if (_serial.available())
-					{
-						auto c = _serial.read();
-						readBytes++;
-					}
-				}
-
-				return;
+				_state = ParserState::Timeout;
 			}
+			_parserContext.CipsendState = CipsendStateType::SendingData;
+			_parserContext.CipsendDataWritten = 0;
+			_parserContext.CipsendEchoReceived = 0;
+			_response.clear();
+			return;
 		}
 	}
+	if (IsCipsendEcho(c))
+	{
+		_parserContext.CipsendEchoReceived++;
+		return;
+	}
 	if (_parserContext.CiprxGetLeftBytesToRead > 0)
 	{
-		_parserContext.CipRxGetBuffer->append(c);
-		_parserContext.CiprxGetLeftBytesToRead--;
+		AppendPayload(reinterpret_cast<const uint8_t*>(&c), 1);
 		return;
 	}	
 	int prevState = lineParserState;
@@ -127,7 +133,8 @@ void SimcomResponseParser::FeedChar(char c)
 			_logger.Log(F(" '%s'"), printableLine.c_str());
 			// do nothing, do not change _state to none
 		}
-		else
+		// in batch, error of one query must not be overwritten by success of next one
+		else if (!(parseResult == ParserState::PartialSuccess && _state == ParserState::PartialError))
 		{
 			_state = parseResult;
 		}
@@ -137,6 +144,138 @@ void SimcomResponseParser::FeedChar(char c)
 
 }
 
+/* 
+processes block of characters read from serial port of gsm module,
+text between line delimiters and CIPRXGET payload are copied in one go.
+Returns number of consumed characters, processing stops when command becomes ready
+so the rest of block can be parsed in context of next command
+*/
+size_t SimcomResponseParser::FeedChars(const uint8_t* data, size_t length)
+{
+	const bool wasCommandReady = commandReady;
+	size_t position = 0;
+	while (position < length)
+	{
+		if (!wasCommandReady && commandReady)
+		{
+			break;
+		}
+		if (_parserContext.CiprxGetLeftBytesToRead > 0)
+		{
+			size_t payloadLength = length - position;
+			if (payloadLength > _parserContext.CiprxGetLeftBytesToRead)
+			{
+				payloadLength = _parserContext.CiprxGetLeftBytesToRead;
+			}
+			AppendPayload(data + position, payloadLength);
+			position += payloadLength;
+			continue;
+		}
+		const char c = data[position];
+		// prompt detection, payload echo and line delimiters go through state machine
+		if (IsWaitingForPrompt() || IsCipsendEcho(c) || lineParserState == PARSER_CR || c == '\r' || c == '\n')
+		{
+			FeedChar(c);
+			position++;
+			continue;
+		}
+		size_t segmentEnd = position + 1;
+		while (segmentEnd < length && data[segmentEnd] != '\r' && data[segmentEnd] != '\n')
+		{
+			segmentEnd++;
+		}
+		_response.append(reinterpret_cast<const char*>(data + position), segmentEnd - position);
+		lineParserState = PARSER_LINE;
+		position = segmentEnd;
+	}
+	return position;
+}
+
+void SimcomResponseParser::AppendPayload(const uint8_t* data, size_t length)
+{
+	_parserContext.CiprxGetLeftBytesToRead -= length;
+	if (_parserContext.CipRxGetData == nullptr)
+	{
+		_parserContext.CipRxGetBuffer->append(reinterpret_cast<const char*>(data), length);
+		return;
+	}
+	const size_t freeSpace = _parserContext.CipRxGetDataCapacity - _parserContext.CipRxGetDataLength;
+	if (length > freeSpace)
+	{
+		length = freeSpace;
+	}
+	memcpy(_parserContext.CipRxGetData + _parserContext.CipRxGetDataLength, data, length);
+	_parserContext.CipRxGetDataLength += length;
+}
+
+/* 
+returns space in binary CIPRXGET buffer that caller can fill directly from serial port,
+must be followed by PayloadReceived()
+*/
+size_t SimcomResponseParser::GetPayloadBuffer(uint8_t*& destination)
+{
+	if (_parserContext.CiprxGetLeftBytesToRead == 0 || _parserContext.CipRxGetData == nullptr)
+	{
+		return 0;
+	}
+	size_t length = _parserContext.CipRxGetDataCapacity - _parserContext.CipRxGetDataLength;
+	if (length > _parserContext.CiprxGetLeftBytesToRead)
+	{
+		length = _parserContext.CiprxGetLeftBytesToRead;
+	}
+	destination = _parserContext.CipRxGetData + _parserContext.CipRxGetDataLength;
+	return length;
+}
+
+void SimcomResponseParser::PayloadReceived(size_t length)
+{
+	_parserContext.CipRxGetDataLength += length;
+	_parserContext.CiprxGetLeftBytesToRead -= length;
+}
+
+/* prompt may follow echo whose line end was lost, echo of CIPSEND never contains it */
+bool SimcomResponseParser::IsWaitingForPrompt()
+{
+	return !_staleResponse &&
+		_currentCommand == AtCommand::CipSend &&
+		_parserContext.CipsendState == CipsendStateType::WaitingForPrompt;
+}
+
+uint8_t SimcomResponseParser::CipsendByte(uint16_t position)
+{
+	for (uint8_t i = 0; i < _parserContext.CipsendSegmentCount; i++)
+	{
+		const auto &segment = _parserContext.CipsendSegments[i];
+		if (position < segment.Length)
+		{
+			// filler is written for data of detached socket
+			return segment.Data != nullptr ? segment.Data[position] : 0;
+		}
+		position -= segment.Length;
+	}
+	return 0;
+}
+
+/*
+payload written after CIPSEND prompt is repeated by modem when echo is on,
+byte that doesn't match written payload means echo was lost and it is parsed as response
+*/
+bool SimcomResponseParser::IsCipsendEcho(char c)
+{
+	if (!_parserContext.EchoEnabled || _currentCommand != AtCommand::CipSend ||
+		_parserContext.CipsendState == CipsendStateType::WaitingForPrompt ||
+		_parserContext.CipsendEchoReceived >= _parserContext.CipsendDataWritten)
+	{
+		return false;
+	}
+	if (CipsendByte(_parserContext.CipsendEchoReceived) != static_cast<uint8_t>(c))
+	{
+		_parserContext.CipsendEchoReceived = _parserContext.CipsendLength;
+		return false;
+	}
+	return true;
+}
+
 void SimcomResponseParser::OnDataReceived(DataReceivedCallback onDataReceived)
 {
 	_dataReceivedCallback = onDataReceived;
@@ -165,448 +304,906 @@ bool SimcomResponseParser::IsOkLine()
 	return _response == F("OK");
 }
 
-bool SimcomResponseParser::ParseUnsolicited(FixedStringBase& line)
+struct UnsolicitedEntry
 {
+	const char *Prefix;
+	UnsolicitedType Type;
+};
 
+static const char RingPrefix[] PROGMEM = "RING";
+static const char ClipPrefix[] PROGMEM = "+CLIP: ";
+static const char CmtiPrefix[] PROGMEM = "+CMTI: ";
+static const char CregPrefix[] PROGMEM = "+CREG: ";
+static const char CipRxGetNotificationPrefix[] PROGMEM = "+CIPRXGET: 1,";
+static const char ReceivePrefix[] PROGMEM = "+RECEIVE,";
+static const char PdpDeactPrefix[] PROGMEM = "+PDP: DEACT";
+static const char UnderVoltagePrefix[] PROGMEM = "UNDER-VOLTAGE";
 
-	if(line.equals(F("+CIPRXGET: 1,0")))
+static const UnsolicitedEntry UnsolicitedEntries[] =
+{
+	{ RingPrefix, UnsolicitedType::Ring },
+	{ ClipPrefix, UnsolicitedType::CallerId },
+	{ CmtiPrefix, UnsolicitedType::NewSms },
+	{ CregPrefix, UnsolicitedType::RegistrationChanged },
+	{ CipRxGetNotificationPrefix, UnsolicitedType::DataReceived },
+	{ ReceivePrefix, UnsolicitedType::DataReceived },
+	{ PdpDeactPrefix, UnsolicitedType::PdpDeact },
+	{ UnderVoltagePrefix, UnsolicitedType::UnderVoltage },
+	{ nullptr, UnsolicitedType::Ring }
+};
+
+void SimcomResponseParser::OnUnsolicited(UnsolicitedType type, UnsolicitedCallback callback, void* state)
+{
+	const auto index = static_cast<uint8_t>(type);
+	_unsolicitedCallbacks[index] = callback;
+	_unsolicitedCallbackStates[index] = state;
+}
+
+void SimcomResponseParser::SetRxDataPending(uint8_t mux, bool pending)
+{
+	if (mux >= MAX_CONNECTIONS)
 	{
-		return true;
+		return;
+	}
+	if (pending)
+	{
+		_parserContext.RxDataPending |= 1 << mux;
 	}
+	else
+	{
+		_parserContext.RxDataPending &= ~(1 << mux);
+	}
+}
+
+void SimcomResponseParser::OnConnectionEvent(UnsolicitedCallback callback, void* state)
+{
+	_connectionEventCallback = callback;
+	_connectionEventCallbackState = state;
+}
+
+/* returns true if line is unsolicited result code, registered handler is called with parsed fields */
+bool SimcomResponseParser::ParseUnsolicited(FixedStringBase& line)
+{
+	UnsolicitedResult result;
 	DelimParser parser(line);
 
-	uint8_t mux;
-	if (parser.NextNum(mux))
+	// <n>, <event> lines of multi connection mode
+	if (line[0] >= '0' && line[0] <= '5' && line[1] == ',')
 	{
-		FixedString50 str;
-		if (mux <= 5)
+		TokenView eventStr;
+		if (!parser.NextNum(result.Mux) || !parser.NextToken(eventStr))
 		{
-			if (parser.NextString(str))
+			return false;
+		}
+		if (!ParsingHelpers::ParseConnectionEvent(eventStr, result.Type))
+		{
+			// CLOSE OK is response to AT+CIPCLOSE
+			if (_currentCommand == AtCommand::Cipclose && eventStr == F("CLOSE OK"))
 			{
-				_logger.Log(F("Mux: %d, event = %s"), mux, str.c_str());
-				return true;
+				return false;
 			}
+			// SEND OK/SEND FAIL is response to CIPSEND of the mux without AT+CIPQSEND=1
+			if (_currentCommand == AtCommand::CipSend && result.Mux == _parserContext.CipsendMux &&
+				(eventStr == F("SEND OK") || eventStr == F("SEND FAIL")))
+			{
+				return false;
+			}
+			_logger.Log(F("Mux: %d, event = %.*s"), result.Mux, eventStr.Length, eventStr.Data);
+			return true;
 		}
-	}
-	if (parser.StartsWith(F("+RECEIVE,")))
-	{
-		uint8_t mux;
-		uint16_t dataLength;
-		if (!parser.NextNum(mux))
+		if (result.Type == UnsolicitedType::ConnectOk)
 		{
-			return false;
+			// notification of previous connection on this mux is not valid anymore
+			SetRxDataPending(result.Mux, false);
 		}
-		parser.SetSeparator(':');
-		return parser.NextNum(dataLength);		
+		DispatchUnsolicited(result);
+		return true;
 	}
-	return false;
-}
 
-ParserState SimcomResponseParser::ParseLine()
-{
-	if (_state == ParserState::WaitingForEcho)
+	const UnsolicitedEntry *entry = UnsolicitedEntries;
+	while (entry->Prefix != nullptr)
 	{
-		if (_response.equals(_currentCommandStr))
+		// cheap first character check before comparing whole prefix
+		if (pgm_read_byte(entry->Prefix) == line[0] && parser.StartsWith(reinterpret_cast<const __FlashStringHelper*>(entry->Prefix)))
 		{
-			return ParserState::Timeout;
+			break;
 		}
-		return ParserState::None;
+		entry++;
 	}
+	if (entry->Prefix == nullptr)
+	{
+		return false;
+	}
+	result.Type = entry->Type;
 
-	DelimParser parser(_response);
-
-
-	if (_currentCommand == AtCommand::Cpin)
+	switch (result.Type)
 	{
-		if (IsErrorLine())
-		{
-			_parserContext.SimStatus = SimState::NotInserted;
-			return ParserState::Success;
-		}
-		if (_response == F("+CPIN: READY"))
+	case UnsolicitedType::CallerId:
+		if (!parser.NextString(result.Text))
 		{
-			_parserContext.SimStatus = SimState::Ok;
-			return ParserState::PartialSuccess;
+			return false;
 		}
-		if (_response == F("+CPIN: SIM PIN"))
+		break;
+	case UnsolicitedType::NewSms:
+		if (!parser.NextString(result.Text) || !parser.NextNum(result.Value))
 		{
-			_parserContext.SimStatus = SimState::Locked;
-			return ParserState::PartialSuccess;
+			return false;
 		}
-		if (_response == F("+CPIN: SIM PUK"))
+		break;
+	case UnsolicitedType::RegistrationChanged:
+		// +CREG: <n>,<stat> is response to AT+CREG?, URC is +CREG: <stat>[,<lac>,<ci>]
+		if (IsCommand(AtCommand::Creg))
 		{
-			_parserContext.SimStatus = SimState::Locked;
-			return ParserState::PartialSuccess;
+			return false;
 		}
-	}
-
-	if(_currentCommand == AtCommand::Generic)
-	{
-		if (IsErrorLine())
+		if (!parser.NextNum(result.Value) ||
+			!ParsingHelpers::ParseRegistrationStatus(result.Value, _parserContext.RegistrationStatus))
 		{
-			return ParserState::Error;
+			return false;
 		}
-		if (IsOkLine())
+		break;
+	case UnsolicitedType::DataReceived:
+		if (!parser.NextNum(result.Mux))
 		{
-			return ParserState::Success;
+			return false;
 		}
-	}
-	
-	if(_currentCommand == AtCommand::Cipstatus)
-	{
-		static uint8_t internalState = 0;
-		// Cipstatus returns OK first, then IP STATE: xxxx
-		if (IsOkLine())
+		if (entry->Prefix == CipRxGetNotificationPrefix)
 		{
-			internalState = 0;
-			return ParserState::PartialSuccess;
+			SetRxDataPending(result.Mux, true);
 		}
-		if (_state == ParserState::PartialSuccess)
+		// +RECEIVE,<n>,<length>:
+		if (entry->Prefix == ReceivePrefix)
 		{
-			if (internalState == 0)
-			{
-				if (ParsingHelpers::ParseIpStatus(_response.c_str(), *_parserContext.IpState))
-				{
-					if (!_parserContext.Cipmux)
-					{
-						return ParserState::Success;
-					}
-					internalState = 1;
-					return ParserState::PartialSuccess;
-				}
-			}
-			if (internalState >= 1)
-			{
-				if(parser.StartsWith(F("C: ")))
-				{ 
-					internalState++;
-					if (internalState == 7)
-					{
-						return ParserState::Success;
-					}
-					return ParserState::PartialSuccess;
-				}
-			}			
-		}
-	}
-	if (_currentCommand == AtCommand::CipstatusSingleConnection)
-	{
-		if (parser.StartsWith(F("+CIPSTATUS: ")))
-		{
-			uint8_t mux;
-			uint8_t bearer;
-			FixedString20 protocolStr;
-			FixedString20 ipAddressStr;
-			uint16_t port;
-			FixedString20 connectionStateStr;
-			if (parser.NextNum(mux) &&
-				parser.NextNum(bearer, true) &&
-				parser.NextString(protocolStr) &&
-				parser.NextString(ipAddressStr) &&
-				parser.NextNum(port, true) &&
-				parser.NextString(connectionStateStr))
+			parser.SetSeparator(':');
+			if (!parser.NextNum(result.Value))
 			{
-				ProtocolType protocolType;
-				ConnectionState connectionState;
-
-				if(ParsingHelpers::ParseConnectionState(connectionStateStr, connectionState))
-				{
-					auto connInfo = _parserContext.CurrentConnectionInfo;
-
-					connInfo->Mux = mux;
-					connInfo->Bearer = bearer;
-
-					if (protocolStr.length() > 0 && !ParsingHelpers::ParseProtocolType(protocolStr, connInfo->Protocol))
-					{
-						return ParserState::PartialError;
-					}
-					if (ipAddressStr.length() > 0 && !ParsingHelpers::ParseIpAddress(ipAddressStr, connInfo->RemoteAddress))
-					{
-						return ParserState::PartialError;
-					}
-
-					connInfo->Port = port;
-					connInfo->State = connectionState;
-					return ParserState::PartialSuccess;
-				}
+				return false;
 			}
-			return ParserState::PartialError;
 		}
+		break;
+	case UnsolicitedType::UnderVoltage:
+		result.Value = line.endsWith(F("POWER DOWN")) ? 1 : 0;
+		break;
+	default:
+		break;
 	}
+	DispatchUnsolicited(result);
+	return true;
+}
+
+void SimcomResponseParser::DispatchUnsolicited(UnsolicitedResult& result)
+{
+	const auto index = static_cast<uint8_t>(result.Type);
+	_logger.LogAt(F("    URC %d, mux = %d, value = %d"), index, result.Mux, result.Value);
+	const bool isConnectionEvent = result.Type == UnsolicitedType::ConnectOk || result.Type == UnsolicitedType::ConnectFail ||
+		result.Type == UnsolicitedType::AlreadyConnected || result.Type == UnsolicitedType::ConnectionClosed ||
+		result.Type == UnsolicitedType::DataReceived;
+	if (isConnectionEvent && _connectionEventCallback != nullptr)
+	{
+		_connectionEventCallback(result, _connectionEventCallbackState);
+	}
+	if (_unsolicitedCallbacks[index] == nullptr)
+	{
+		return;
+	}
+	// handler may send commands, so it is called after parsing of received block is finished
+	if (_unsolicitedQueueCount == UNSOLICITED_QUEUE_SIZE)
+	{
+		_logger.Log(F("Unsolicited queue full, URC %d dropped"), index);
+		return;
+	}
+	_unsolicitedQueue[(_unsolicitedQueueHead + _unsolicitedQueueCount) % UNSOLICITED_QUEUE_SIZE] = result;
+	_unsolicitedQueueCount++;
+}
 
-	if (_currentCommand == AtCommand::CipRxGetRead)
+/* calls registered handlers of queued URCs, handler may call this again through blocking command */
+void SimcomResponseParser::DispatchQueuedUnsolicited()
+{
+	while (_unsolicitedQueueCount > 0)
 	{
-		if (parser.StartsWith(F("+CIPRXGET: ")))
+		UnsolicitedResult result = _unsolicitedQueue[_unsolicitedQueueHead];
+		_unsolicitedQueueHead = (_unsolicitedQueueHead + 1) % UNSOLICITED_QUEUE_SIZE;
+		_unsolicitedQueueCount--;
+		const auto index = static_cast<uint8_t>(result.Type);
+		if (_unsolicitedCallbacks[index] != nullptr)
 		{
-			uint8_t mode;
-			uint8_t mux;
-			uint16_t dataSize;
-			uint16_t dataLeft;
-			if (parser.NextNum(mode) &&
-				parser.NextNum(mux) &&
-				parser.NextNum(dataSize) && 
-				parser.NextNum(dataLeft))
-			{
-				_parserContext.CiprxGetLeftBytesToRead = dataSize;
-				return ParserState::PartialSuccess;				 
-			}
+			_unsolicitedCallbacks[index](result, _unsolicitedCallbackStates[index]);
 		}
 	}
+}
+
+static const char CipstatusSingleConnectionPrefix[] PROGMEM = "+CIPSTATUS: ";
+static const char CipRxGetReadPrefix[] PROGMEM = "+CIPRXGET: ";
+static const char CsqPrefix[] PROGMEM = "+CSQ: ";
+static const char CbcPrefix[] PROGMEM = "+CBC: ";
+static const char ClccPrefix[] PROGMEM = "+CLCC: ";
+static const char CopsPrefix[] PROGMEM = "+COPS: ";
+static const char CusdPrefix[] PROGMEM = "+CUSD: ";
+static const char CipmuxPrefix[] PROGMEM = "+CIPMUX: ";
+static const char CipQsendPrefix[] PROGMEM = "+CIPQSEND: ";
+static const char CipSendPrefix[] PROGMEM = "+CIPSEND: ";
+static const char CipAckPrefix[] PROGMEM = "+CIPACK: ";
+static const char CipRxGetPrefix[] PROGMEM = "+CIPRXGET:";
+static const char CregResponsePrefix[] PROGMEM = "+CREG: ";
+
+struct CsqResponse
+{
+	uint8_t Rssi;
+	uint8_t Ber;
+};
+// +CSQ: 17,0
+typedef ResponseGrammar<CsqResponse,
+	NumField<CsqResponse, uint8_t, &CsqResponse::Rssi>,
+	NumField<CsqResponse, uint8_t, &CsqResponse::Ber>> CsqGrammar;
+
+struct CbcResponse
+{
+	uint8_t Percent;
+	uint16_t VoltageMv;
+};
+// +CBC: 0,87,4100
+typedef ResponseGrammar<CbcResponse,
+	SkipFields<1>,
+	NumField<CbcResponse, uint8_t, &CbcResponse::Percent>,
+	NumField<CbcResponse, uint16_t, &CbcResponse::VoltageMv>> CbcGrammar;
+
+struct CopsResponse
+{
+	uint16_t Mode;
+	uint16_t Format;
+	FixedStringBase *OperatorName;
+};
+// +COPS: 0,0,"PLAY" or +COPS: 0 when no operator is selected
+typedef ResponseGrammar<CopsResponse,
+	NumField<CopsResponse, uint16_t, &CopsResponse::Mode>,
+	OptionalFields<
+		NumField<CopsResponse, uint16_t, &CopsResponse::Format>,
+		StrField<CopsResponse, FixedStringBase*, &CopsResponse::OperatorName>>> CopsGrammar;
+
+struct CregResponse
+{
+	uint8_t Status;
+};
+// +CREG: 2,1,"07E6","D68F"
+typedef ResponseGrammar<CregResponse,
+	SkipFields<1>,
+	NumField<CregResponse, uint8_t, &CregResponse::Status>> CregGrammar;
+
+struct CusdResponse
+{
+	uint8_t Status;
+	FixedStringBase *Text;
+};
+// +CUSD: 0,"Balance 5.00",15
+typedef ResponseGrammar<CusdResponse,
+	NumField<CusdResponse, uint8_t, &CusdResponse::Status>,
+	StrField<CusdResponse, FixedStringBase*, &CusdResponse::Text>> CusdGrammar;
+
+struct ClccResponse
+{
+	FixedStringBase *Number;
+};
+// +CLCC: 1,1,4,0,0,"+48123456789",145,""
+typedef ResponseGrammar<ClccResponse,
+	SkipFields<5>,
+	StrField<ClccResponse, FixedStringBase*, &ClccResponse::Number>> ClccGrammar;
+
+struct CipRxGetReadResponse
+{
+	uint8_t Mode;
+	uint8_t Mux;
+	uint16_t Length;
+	uint16_t Left;
+};
+// +CIPRXGET: 2,0,20,5
+typedef ResponseGrammar<CipRxGetReadResponse,
+	NumField<CipRxGetReadResponse, uint8_t, &CipRxGetReadResponse::Mode>,
+	NumField<CipRxGetReadResponse, uint8_t, &CipRxGetReadResponse::Mux>,
+	NumField<CipRxGetReadResponse, uint16_t, &CipRxGetReadResponse::Length>,
+	NumField<CipRxGetReadResponse, uint16_t, &CipRxGetReadResponse::Left>> CipRxGetReadGrammar;
+// +CIPRXGET: 4,0,1200
+typedef ResponseGrammar<CipRxGetReadResponse,
+	NumField<CipRxGetReadResponse, uint8_t, &CipRxGetReadResponse::Mode>,
+	NumField<CipRxGetReadResponse, uint8_t, &CipRxGetReadResponse::Mux>,
+	NumField<CipRxGetReadResponse, uint16_t, &CipRxGetReadResponse::Left>> CipRxGetLengthGrammar;
+
+struct CipstatusConnectionResponse
+{
+	uint8_t Mux;
+	uint8_t Bearer;
+	TokenView Protocol;
+	TokenView Address;
+	uint16_t Port;
+	TokenView State;
+};
+// +CIPSTATUS: 0,0,"TCP","123.123.123.123","80","CONNECTED" or +CIPSTATUS: 1,,"","","","INITIAL"
+typedef ResponseGrammar<CipstatusConnectionResponse,
+	NumField<CipstatusConnectionResponse, uint8_t, &CipstatusConnectionResponse::Mux>,
+	NumField<CipstatusConnectionResponse, uint8_t, &CipstatusConnectionResponse::Bearer, true>,
+	StrField<CipstatusConnectionResponse, TokenView, &CipstatusConnectionResponse::Protocol>,
+	StrField<CipstatusConnectionResponse, TokenView, &CipstatusConnectionResponse::Address>,
+	NumField<CipstatusConnectionResponse, uint16_t, &CipstatusConnectionResponse::Port, true>,
+	StrField<CipstatusConnectionResponse, TokenView, &CipstatusConnectionResponse::State>> CipstatusConnectionGrammar;
+
+struct EnabledResponse
+{
+	uint8_t IsEnabled;
+};
+// +CIPMUX: 1, +CIPQSEND: 1, +CIPRXGET: 1
+typedef ResponseGrammar<EnabledResponse,
+	NumField<EnabledResponse, uint8_t, &EnabledResponse::IsEnabled>> EnabledGrammar;
+
+struct SendWindowResponse
+{
+	uint8_t Mux;
+	uint16_t Size;
+};
+// +CIPSEND: 0,1460 in multi connection mode
+typedef ResponseGrammar<SendWindowResponse,
+	NumField<SendWindowResponse, uint8_t, &SendWindowResponse::Mux>,
+	NumField<SendWindowResponse, uint16_t, &SendWindowResponse::Size>> SendWindowGrammar;
+// +CIPSEND: 1460
+typedef ResponseGrammar<SendWindowResponse,
+	NumField<SendWindowResponse, uint16_t, &SendWindowResponse::Size>> SingleSendWindowGrammar;
+
+struct CipAckResponse
+{
+	uint32_t TxLength;
+	uint32_t AckLength;
+	uint32_t NackLength;
+};
+// +CIPACK: 2920,2920,0
+typedef ResponseGrammar<CipAckResponse,
+	NumField<CipAckResponse, uint32_t, &CipAckResponse::TxLength>,
+	NumField<CipAckResponse, uint32_t, &CipAckResponse::AckLength>,
+	NumField<CipAckResponse, uint32_t, &CipAckResponse::NackLength>> CipAckGrammar;
+
+/* 
+Response descriptors indexed by AtCommand. Handler is called only for lines starting with prefix,
+or for every line when prefix is null. OK/ERROR lines not handled by command are checked in ParseLine
+*/
+const SimcomResponseParser::ResponseDescriptor SimcomResponseParser::ResponseDescriptors[] =
+{
+	/* Generic */					{ nullptr, nullptr, true },
+	/* Cpin */						{ nullptr, &SimcomResponseParser::ParseCpin, false },
+	/* Cipstatus */					{ nullptr, &SimcomResponseParser::ParseCipstatus, false },
+	/* CipstatusSingleConnection */	{ CipstatusSingleConnectionPrefix, &SimcomResponseParser::ParseCipstatusSingleConnection, false },
+	/* Csq */						{ CsqPrefix, &SimcomResponseParser::ParseCsq, false },
+	/* Cifsr */						{ nullptr, &SimcomResponseParser::ParseCifsr, false },
+	/* Cipstart */					{ nullptr, &SimcomResponseParser::ParseCipstart, false },
+	/* Cops */						{ CopsPrefix, &SimcomResponseParser::ParseCops, false },
+	/* Creg */						{ CregResponsePrefix, &SimcomResponseParser::ParseCreg, false },
+	/* Gsn */						{ nullptr, &SimcomResponseParser::ParseGsn, false },
+	/* Cipshut */					{ nullptr, &SimcomResponseParser::ParseCipshut, false },
+	/* Cipclose */					{ nullptr, &SimcomResponseParser::ParseCipclose, false },
+	/* Cusd */						{ CusdPrefix, &SimcomResponseParser::ParseCusd, false },
+	/* Cbc */						{ CbcPrefix, &SimcomResponseParser::ParseCbc, false },
+	/* Clcc */						{ ClccPrefix, &SimcomResponseParser::ParseClcc, true },
+	/* Cipmux */					{ CipmuxPrefix, &SimcomResponseParser::ParseCipmux, false },
+	/* CipRxGet */					{ CipRxGetPrefix, &SimcomResponseParser::ParseCipRxGet, false },
+	/* CipRxGetRead */				{ CipRxGetReadPrefix, &SimcomResponseParser::ParseCipRxGetRead, false },
+	/* CipQsendQuery */				{ CipQsendPrefix, &SimcomResponseParser::ParseCipQsendQuery, false },
+	/* CipSend */					{ nullptr, &SimcomResponseParser::ParseCipSend, false },
+	/* CipSendQuery */				{ CipSendPrefix, &SimcomResponseParser::ParseCipSendQuery, false },
+	/* CipRxGetLength */			{ CipRxGetReadPrefix, &SimcomResponseParser::ParseCipRxGetLength, false },
+	/* CipAck */					{ CipAckPrefix, &SimcomResponseParser::ParseCipAck, false },
+	/* Batch */						{ nullptr, nullptr, true },
+};
+
+static_assert(sizeof(SimcomResponseParser::ResponseDescriptors) / sizeof(SimcomResponseParser::ResponseDescriptors[0]) == AtCommandCount,
+	"ResponseDescriptors must have entry for every AtCommand");
 
-	if(_currentCommand == AtCommand::Csq)
+ParserState SimcomResponseParser::ParseLine()
+{
+	if (_state == ParserState::WaitingForEcho)
 	{
-		//+CSQ: 17,0
-		if(parser.StartsWith(F("+CSQ: ")))
+		if (IsEcho())
 		{
-			uint16_t signalQuality;
-			uint16_t signalStrength;
-
-			if (parser.NextNum(signalQuality) && parser.NextNum(signalStrength))
-			{
-				*_parserContext.CsqSignalQuality = signalQuality;
-				return ParserState::PartialSuccess;
-			}
-			return ParserState::PartialError;
+			_staleResponse = false;
+			return ParserState::Timeout;
+		}
+		if (_staleResponse)
+		{
+			return ParserState::None;
 		}
+		// echo was lost, nothing else is expected before response so line belongs to current command
+		_state = ParserState::Timeout;
 	}
 
-	if (_currentCommand == AtCommand::Cbc)
+	DelimParser parser(_response);
+	ParserState result = ParserState::None;
+
+	if (_currentCommand == AtCommand::Batch)
 	{
-		if (parser.StartsWith(F("+CBC: ")))
+		for (uint8_t command = 0; command < AtCommandCount && result == ParserState::None; command++)
 		{
-			uint16_t batteryPercent;
-			uint16_t mVbatteryVoltage;
-
-			if (!parser.Skip(1) || 
-				!parser.NextNum(batteryPercent) ||
-				!parser.NextNum(mVbatteryVoltage))
+			if (_parserContext.BatchCommands & BatchCommandBit(static_cast<AtCommand>(command)))
 			{
-				return ParserState::PartialError;
+				result = ParseCommandLine(static_cast<AtCommand>(command), parser);
 			}
-			_parserContext.BatteryInfo->Voltage = mVbatteryVoltage / 1000.0;
-			_parserContext.BatteryInfo->Percent = batteryPercent;
-			return ParserState::PartialSuccess;			
 		}
 	}
-
-	if(_currentCommand == AtCommand::Cifsr)
+	else
 	{
-		GsmIp ip;
-		if (ParsingHelpers::ParseIpAddress(_response, ip))
-		{
-			*_parserContext.IpAddress = ip;
-			return ParserState::PartialSuccess;
-		}
+		result = ParseCommandLine(_currentCommand, parser);
+	}
+	if (result != ParserState::None)
+	{
+		return result;
 	}
 
-	if (_currentCommand == AtCommand::Clcc)
+	if (IsOkLine())
 	{
-		if (parser.StartsWith(F("+CLCC: ")))
+		if (_state == ParserState::PartialError)
 		{
-			if (!parser.Skip(5))
-			{
-				return ParserState::PartialError;
-			}
-			FixedString20 number;			
-			if (!parser.NextString(number))
-			{
-				return ParserState::PartialError;
-			}
-			_parserContext.CallInfo->CallerNumber = number;
-			_parserContext.CallInfo->HasIncomingCall = true;	
-			return ParserState::PartialSuccess;
+			return ParserState::Error;
 		}
-		// CLCC can return no records so it's ok
-		if (IsOkLine())
+		if (_state == ParserState::PartialSuccess || ResponseDescriptors[static_cast<uint8_t>(_currentCommand)].CompletesOnOk)
 		{
 			return ParserState::Success;
 		}
 	}
+	if (IsErrorLine())
+	{
+		return ParserState::Error;
+	}
+
+	return ParserState::None;
+}
 
-	if(_currentCommand == AtCommand::Cipstart)
+/* 
+echo of current command, line with up to 2 consecutive characters lost on UART still matches
+so single dropped byte doesn't cost whole command timeout
+*/
+bool SimcomResponseParser::IsEcho()
+{
+	if (_response.equals(_currentCommandStr))
 	{
-		if (_response == F("CONNECT"))
+		return true;
+	}
+	const auto lineLength = _response.length();
+	const auto commandLength = _currentCommandStr.length();
+	if (lineLength < 2 || lineLength >= commandLength || lineLength + 2 < commandLength)
+	{
+		return false;
+	}
+	const auto line = _response.c_str();
+	const auto command = _currentCommandStr.c_str();
+	size_t prefix = 0;
+	while (prefix < lineLength && line[prefix] == command[prefix])
+	{
+		prefix++;
+	}
+	size_t suffix = 0;
+	while (suffix < lineLength - prefix && line[lineLength - 1 - suffix] == command[commandLength - 1 - suffix])
+	{
+		suffix++;
+	}
+	return prefix + suffix == lineLength;
+}
+
+/*
+called when current command timed out, clears partially received line and payload
+and discards lines until echo of next command is received or next command is sent when echo is off
+*/
+void SimcomResponseParser::DiscardResponse()
+{
+	_staleResponse = true;
+	_state = ParserState::WaitingForEcho;
+	_response.clear();
+	lineParserState = PARSER_INITIAL;
+	_parserContext.CiprxGetLeftBytesToRead = 0;
+	_parserContext.CipRxGetData = nullptr;
+}
+
+ParserState SimcomResponseParser::ParseCommandLine(AtCommand command, DelimParser& parser)
+{
+	const auto &descriptor = ResponseDescriptors[static_cast<uint8_t>(command)];
+	if (descriptor.Handler == nullptr)
+	{
+		return ParserState::None;
+	}
+	if (descriptor.Prefix != nullptr && !parser.StartsWith(reinterpret_cast<const __FlashStringHelper*>(descriptor.Prefix)))
+	{
+		return ParserState::None;
+	}
+	return (this->*descriptor.Handler)(parser);
+}
+
+ParserState SimcomResponseParser::ParseCpin(DelimParser&)
+{
+	if (IsErrorLine())
+	{
+		_parserContext.SimStatus = SimState::NotInserted;
+		return ParserState::Success;
+	}
+	if (_response == F("+CPIN: READY"))
+	{
+		_parserContext.SimStatus = SimState::Ok;
+		return ParserState::PartialSuccess;
+	}
+	if (_response == F("+CPIN: SIM PIN"))
+	{
+		_parserContext.SimStatus = SimState::Locked;
+		return ParserState::PartialSuccess;
+	}
+	if (_response == F("+CPIN: SIM PUK"))
+	{
+		_parserContext.SimStatus = SimState::Locked;
+		return ParserState::PartialSuccess;
+	}
+	return ParserState::None;
+}
+
+ParserState SimcomResponseParser::ParseCipstatus(DelimParser& parser)
+{
+	// Cipstatus returns OK first, then STATE: xxxx, in multi connection mode followed by C: line of every connection
+	if (IsOkLine())
+	{
+		_cipstatusLines = 0;
+		return ParserState::PartialSuccess;
+	}
+	if (_state != ParserState::PartialSuccess)
+	{
+		return ParserState::None;
+	}
+	if (_cipstatusLines == 0)
+	{
+		if (!ParsingHelpers::ParseIpStatus(_response.c_str(), *_parserContext.IpState))
 		{
-			return ParserState::Success;
+			return ParserState::None;
 		}
-		if (_response == F("CONNECT FAIL") || _response == F("+PDP: DEACT"))
+		if (!_parserContext.Cipmux)
 		{
-			return ParserState::Error;
+			return ParserState::Success;
 		}
+		_cipstatusLines = 1;
+		return ParserState::PartialSuccess;
 	}
-	if(_currentCommand == AtCommand::Cipshut)
+	if (!parser.StartsWith(F("C: ")))
 	{
-		if (_response.equals(F("SHUT OK")))
-		{
-			return ParserState::Success;
-		}
+		return ParserState::None;
 	}
-	if(_currentCommand == AtCommand::Cipclose)
+	// connection that can't be parsed keeps previous info, it doesn't fail status of the others
+	ConnectionInfo connectionInfo;
+	if (_parserContext.Connections != nullptr && ParseConnectionInfo(parser, connectionInfo) && connectionInfo.Mux < MAX_CONNECTIONS)
 	{
-		if (_response.equals(F("CLOSE OK")))
-		{
-			return ParserState::Success;
-		}
+		_parserContext.Connections[connectionInfo.Mux] = connectionInfo;
 	}
-	if(_currentCommand == AtCommand::Cops)
+	_cipstatusLines++;
+	if (_cipstatusLines > MAX_CONNECTIONS)
 	{
-		if(parser.StartsWith(F("+COPS: ")))
-		{				
-			uint16_t operatorNameFormat;
+		return ParserState::Success;
+	}
+	return ParserState::PartialSuccess;
+}
 
-			if (!parser.NextNum(_parserContext.operatorSelectionMode) ||
-				!parser.NextNum(operatorNameFormat) || 
-				!parser.NextString(*_parserContext.OperatorName))
-			{
-				return ParserState::PartialError;
-			}
+ParserState SimcomResponseParser::ParseCipstatusSingleConnection(DelimParser& parser)
+{
+	if (!ParseConnectionInfo(parser, *_parserContext.CurrentConnectionInfo))
+	{
+		return ParserState::PartialError;
+	}
+	return ParserState::PartialSuccess;
+}
 
-			_parserContext.IsOperatorNameReturnedInImsiFormat = operatorNameFormat == 2;
-			return ParserState::PartialSuccess;			
-		}
+/* <n>,<bearer>,"TCP","ip","port","state" of +CIPSTATUS: and C: lines */
+bool SimcomResponseParser::ParseConnectionInfo(DelimParser& parser, ConnectionInfo& connectionInfo)
+{
+	CipstatusConnectionResponse response;
+	if (!CipstatusConnectionGrammar::Parse(parser, response))
+	{
+		return false;
 	}
-	if(_currentCommand == AtCommand::Gsn)
+	ConnectionState connectionState;
+	if (!ParsingHelpers::ParseConnectionState(response.State, connectionState))
 	{
-		auto imeiValid = ParsingHelpers::IsImeiValid(_response);
-		if (imeiValid)
-		{
-			*_parserContext.Imei = _response;
-			return ParserState::PartialSuccess;
-		}
+		return false;
 	}
-	if (_currentCommand == AtCommand::Cusd)
+
+	connectionInfo.Mux = response.Mux;
+	connectionInfo.Bearer = response.Bearer;
+
+	if (response.Protocol.Length > 0 && !ParsingHelpers::ParseProtocolType(response.Protocol, connectionInfo.Protocol))
 	{
-		if (parser.StartsWith(F("+CUSD: ")))
-		{
-			uint16_t tmp = 0;
-			if (!parser.NextNum(tmp) ||	
-				!parser.NextString(*_parserContext.UssdResponse))
-			{				
-				return ParserState::PartialError;				
-			}
-			return ParserState::PartialSuccess;
-		}
+		return false;
 	}
-	if (_currentCommand == AtCommand::Cipmux)
+	if (response.Address.Length > 0 && !ParsingHelpers::ParseIpAddress(response.Address, connectionInfo.RemoteAddress))
 	{
-		if (parser.StartsWith(F("+CIPMUX: ")))
-		{
-			uint16_t isEnabled;
-			if (!parser.NextNum(isEnabled))
-			{
-				return ParserState::PartialError;
-			}
-			_parserContext.Cipmux = isEnabled == 1;
-			return ParserState::PartialSuccess;			
-		}		
+		return false;
 	}
-	if(_currentCommand == AtCommand::CipQsendQuery)
+
+	connectionInfo.Port = response.Port;
+	connectionInfo.State = connectionState;
+	return true;
+}
+
+ParserState SimcomResponseParser::ParseCipRxGetRead(DelimParser& parser)
+{
+	CipRxGetReadResponse response;
+	if (!CipRxGetReadGrammar::Parse(parser, response))
 	{
-		if(parser.StartsWith(F("+CIPQSEND: ")))
-		{
-			uint16_t isEnabled;
-			if (!parser.NextNum(isEnabled))
-			{
-				return ParserState::PartialError;
-			}
-			_parserContext.CipQSend = isEnabled == 1;
-			return ParserState::PartialSuccess;
-		}
+		return ParserState::None;
 	}
-	if (_currentCommand == AtCommand::CipRxGet)
+	_parserContext.CiprxGetLeftBytesToRead = response.Length;
+	_parserContext.CipRxGetDataLeft = response.Left;
+	SetRxDataPending(response.Mux, response.Left > 0);
+	return ParserState::PartialSuccess;				 
+}
+
+ParserState SimcomResponseParser::ParseCipRxGetLength(DelimParser& parser)
+{
+	CipRxGetReadResponse response;
+	if (!CipRxGetLengthGrammar::Parse(parser, response) || response.Mode != 4)
 	{
-		if (parser.StartsWith(F("+CIPRXGET:")))
-		{
-			uint16_t isEnabled;
-			if (!parser.NextNum(isEnabled))
-			{
-				return ParserState::PartialError;
-			}
-			_parserContext.IsRxManual = isEnabled == 1;
-			return ParserState::PartialSuccess;
-		}
+		return ParserState::PartialError;
 	}
-	if(_currentCommand == AtCommand::CipSend)
+	_parserContext.CipRxGetDataLeft = response.Left;
+	SetRxDataPending(response.Mux, response.Left > 0);
+	return ParserState::PartialSuccess;
+}
+
+ParserState SimcomResponseParser::ParseCsq(DelimParser& parser)
+{
+	CsqResponse response;
+	if (!CsqGrammar::Parse(parser, response))
 	{
-		if (_parserContext.CipsendState == CipsendStateType::WaitingForDataAccept)
-		{
-			if (parser.StartsWith(F("DATA ACCEPT:")))
-			{
-				uint16_t sentBytes;
-				if (!parser.Skip(1))
-				{
-					return ParserState::Error;
-				}
-
-				if (!parser.NextNum(sentBytes))
-				{
-					return ParserState::Error;
-				}
-				if (sentBytes > _parserContext.CipsendBuffer->length())
-				{
-					return ParserState::Error;
-				}
-				*_parserContext.CipsendSentBytes = sentBytes;
-				return ParserState::Success;				
-			}
-			if (_response.endsWith(F("SEND FAIL")))
-			{
-				_logger.Log(F("CIPSEND failed, SEND FAIL detected"));
-				return ParserState::Error;
-			}
-		}
-		if (_parserContext.CipsendState == CipsendStateType::WaitingForPrompt)
+		return ParserState::PartialError;
+	}
+	*_parserContext.CsqSignalQuality = response.Rssi;
+	return ParserState::PartialSuccess;
+}
+
+ParserState SimcomResponseParser::ParseCbc(DelimParser& parser)
+{
+	CbcResponse response;
+	if (!CbcGrammar::Parse(parser, response))
+	{
+		return ParserState::PartialError;
+	}
+	_parserContext.BatteryInfo->Voltage = response.VoltageMv / 1000.0;
+	_parserContext.BatteryInfo->Percent = response.Percent;
+	return ParserState::PartialSuccess;			
+}
+
+ParserState SimcomResponseParser::ParseCifsr(DelimParser&)
+{
+	GsmIp ip;
+	if (ParsingHelpers::ParseIpAddress(_response, ip))
+	{
+		*_parserContext.IpAddress = ip;
+		return ParserState::PartialSuccess;
+	}
+	return ParserState::None;
+}
+
+ParserState SimcomResponseParser::ParseClcc(DelimParser& parser)
+{
+	ClccResponse response;
+	response.Number = &_parserContext.CallInfo->CallerNumber;
+	if (!ClccGrammar::Parse(parser, response))
+	{
+		return ParserState::PartialError;
+	}
+	_parserContext.CallInfo->HasIncomingCall = true;	
+	return ParserState::PartialSuccess;
+}
+
+ParserState SimcomResponseParser::ParseCipstart(DelimParser&)
+{
+	if (_response == F("CONNECT"))
+	{
+		return ParserState::Success;
+	}
+	if (_response == F("CONNECT FAIL") || _response == F("+PDP: DEACT"))
+	{
+		return ParserState::Error;
+	}
+	return ParserState::None;
+}
+
+ParserState SimcomResponseParser::ParseCipshut(DelimParser&)
+{
+	if (_response.equals(F("SHUT OK")))
+	{
+		return ParserState::Success;
+	}
+	return ParserState::None;
+}
+
+ParserState SimcomResponseParser::ParseCipclose(DelimParser&)
+{
+	// CLOSE OK or <n>, CLOSE OK in multi connection mode
+	if (_response.endsWith(F("CLOSE OK")))
+	{
+		return ParserState::Success;
+	}
+	return ParserState::None;
+}
+
+ParserState SimcomResponseParser::ParseCops(DelimParser& parser)
+{
+	const uint16_t NoOperatorFormat = 0xFFFF;
+	CopsResponse response;
+	response.Format = NoOperatorFormat;
+	response.OperatorName = _parserContext.OperatorName;
+	response.OperatorName->clear();
+	if (!CopsGrammar::Parse(parser, response))
+	{
+		return ParserState::PartialError;
+	}
+	_parserContext.operatorSelectionMode = response.Mode;
+	if (response.Format != NoOperatorFormat)
+	{
+		_parserContext.IsOperatorNameReturnedInImsiFormat = response.Format == 2;
+	}
+	return ParserState::PartialSuccess;			
+}
+
+ParserState SimcomResponseParser::ParseGsn(DelimParser&)
+{
+	auto imeiValid = ParsingHelpers::IsImeiValid(_response);
+	if (imeiValid)
+	{
+		*_parserContext.Imei = _response;
+		return ParserState::PartialSuccess;
+	}
+	return ParserState::None;
+}
+
+ParserState SimcomResponseParser::ParseCusd(DelimParser& parser)
+{
+	CusdResponse response;
+	response.Text = _parserContext.UssdResponse;
+	if (!CusdGrammar::Parse(parser, response))
+	{				
+		return ParserState::PartialError;				
+	}
+	return ParserState::PartialSuccess;
+}
+
+ParserState SimcomResponseParser::ParseCipmux(DelimParser& parser)
+{
+	EnabledResponse response;
+	if (!EnabledGrammar::Parse(parser, response))
+	{
+		return ParserState::PartialError;
+	}
+	_parserContext.Cipmux = response.IsEnabled == 1;
+	return ParserState::PartialSuccess;
+}
+
+ParserState SimcomResponseParser::ParseCipQsendQuery(DelimParser& parser)
+{
+	EnabledResponse response;
+	if (!EnabledGrammar::Parse(parser, response))
+	{
+		return ParserState::PartialError;
+	}
+	_parserContext.CipQSend = response.IsEnabled == 1;
+	return ParserState::PartialSuccess;
+}
+
+ParserState SimcomResponseParser::ParseCipSendQuery(DelimParser& parser)
+{
+	SendWindowResponse response;
+	if (!_parserContext.Cipmux)
+	{
+		if (!SingleSendWindowGrammar::Parse(parser, response))
 		{
-			if(IsErrorLine())
-			{
-				_logger.Log(F("CIPSEND failed, error line detected"));
-				return ParserState::Error;
-			}			
+			return ParserState::PartialError;
 		}
+		_parserContext.SendWindows[0] = response.Size;
+		return ParserState::PartialSuccess;
 	}
-	if(_currentCommand == AtCommand::Creg)
+	if (!SendWindowGrammar::Parse(parser, response) || response.Mux >= MAX_CONNECTIONS)
 	{
-		// example valid line : +CREG: 2,1,"07E6","D68F"
-		if(parser.StartsWith(F("+CREG: ")))
-		{
+		return ParserState::PartialError;
+	}
+	_parserContext.SendWindows[response.Mux] = response.Size;
+	return ParserState::PartialSuccess;
+}
+
+ParserState SimcomResponseParser::ParseCipAck(DelimParser& parser)
+{
+	CipAckResponse response;
+	// remote side can't acknowledge more than was sent, line lost a digit
+	if (!CipAckGrammar::Parse(parser, response) || response.AckLength > response.TxLength)
+	{
+		return ParserState::PartialError;
+	}
+	if (_parserContext.CipAckTxLength != nullptr)
+	{
+		*_parserContext.CipAckTxLength = response.TxLength;
+	}
+	return ParserState::PartialSuccess;
+}
 
+ParserState SimcomResponseParser::ParseCipRxGet(DelimParser& parser)
+{
+	EnabledResponse response;
+	if (!EnabledGrammar::Parse(parser, response))
+	{
+		return ParserState::PartialError;
+	}
+	_parserContext.IsRxManual = response.IsEnabled == 1;
+	return ParserState::PartialSuccess;
+}
+
+ParserState SimcomResponseParser::ParseCipSend(DelimParser& parser)
+{
+	if (_parserContext.CipsendState != CipsendStateType::WaitingForPrompt)
+	{
+		if (parser.StartsWith(F("DATA ACCEPT:")))
+		{
+			uint16_t sentBytes;
 			if (!parser.Skip(1))
 			{
-				return ParserState::PartialError;
+				return ParserState::Error;
 			}
-			uint8_t cregRegistrationState;
-			if (!parser.NextNum(cregRegistrationState))
+
+			if (!parser.NextNum(sentBytes))
 			{
-				return ParserState::PartialError;
+				return ParserState::Error;
 			}
-
-			if (!ParsingHelpers::ParseRegistrationStatus(cregRegistrationState, _parserContext.RegistrationStatus))
+			if (sentBytes > _parserContext.CipsendLength)
 			{
-				return ParserState::PartialError;
+				return ParserState::Error;
 			}
-			return ParserState::PartialSuccess;
-		}	
-	}
-
-	if (IsOkLine())
-	{
-		if (_state == ParserState::PartialSuccess)
+			*_parserContext.CipsendSentBytes = sentBytes;
+			// accepted data occupies modem buffer until it reaches remote side
+			auto &window = _parserContext.SendWindows[_parserContext.CipsendMux];
+			window = sentBytes < window ? window - sentBytes : 0;
+			return ParserState::Success;				
+		}
+		// without AT+CIPQSEND=1 modem confirms whole payload after it reached remote side
+		if (_response.endsWith(F("SEND OK")))
 		{
+			*_parserContext.CipsendSentBytes = _parserContext.CipsendLength;
 			return ParserState::Success;
 		}
-		if (_state == ParserState::PartialError)
+		if (_response.endsWith(F("SEND FAIL")))
 		{
+			_logger.Log(F("CIPSEND failed, SEND FAIL detected"));
 			return ParserState::Error;
 		}
 	}
-	if (IsErrorLine())
+	if (_parserContext.CipsendState == CipsendStateType::WaitingForPrompt)
 	{
-		return ParserState::Error;
+		if(IsErrorLine())
+		{
+			_logger.Log(F("CIPSEND failed, error line detected"));
+			return ParserState::Error;
+		}			
 	}
-
 	return ParserState::None;
 }
 
+ParserState SimcomResponseParser::ParseCreg(DelimParser& parser)
+{
+	CregResponse response;
+	if (!CregGrammar::Parse(parser, response))
+	{
+		return ParserState::PartialError;
+	}
+	if (!ParsingHelpers::ParseRegistrationStatus(response.Status, _parserContext.RegistrationStatus))
+	{
+		return ParserState::PartialError;
+	}
+	return ParserState::PartialSuccess;
+}
+
+/* returns true if command is current one or is part of current batch */
+bool SimcomResponseParser::IsCommand(AtCommand command)
+{
+	if (_currentCommand == command)
+	{
+		return true;
+	}
+	return _currentCommand == AtCommand::Batch && 
+		(_parserContext.BatchCommands & BatchCommandBit(command)) != 0;
+}
+
 void SimcomResponseParser::SetCommandType(AtCommand command, bool expectEcho)
 {		
 	_currentCommand = command;
@@ -617,6 +1214,8 @@ void SimcomResponseParser::SetCommandType(AtCommand command, bool expectEcho)
 	}
 	else
 	{
+		// without echo, lines received after command was sent are its response
+		_staleResponse = false;
 		_state = ParserState::Timeout;
 	}
 }
@@ -22,21 +22,91 @@ class SimcomResponseParser
 	DataReceivedCallback _dataReceivedCallback;
 	bool IsErrorLine();
 	bool IsOkLine();
+	bool IsCommand(AtCommand command);
 	bool ParseUnsolicited(FixedStringBase & line);
+	void DispatchUnsolicited(UnsolicitedResult& result);
+	void SetRxDataPending(uint8_t mux, bool pending);
+	UnsolicitedCallback _unsolicitedCallbacks[UnsolicitedTypeCount];
+	void* _unsolicitedCallbackStates[UnsolicitedTypeCount];
+	// library internal handler of connection URCs, called right when line is parsed, must not send commands
+	UnsolicitedCallback _connectionEventCallback;
+	void* _connectionEventCallbackState;
+	// URCs waiting for their application handler
+	UnsolicitedResult _unsolicitedQueue[UNSOLICITED_QUEUE_SIZE];
+	uint8_t _unsolicitedQueueHead;
+	uint8_t _unsolicitedQueueCount;
 	ParserState ParseLine();
+	bool IsEcho();
+	ParserState ParseCommandLine(AtCommand command, DelimParser& parser);
+	ParserState ParseCpin(DelimParser& parser);
+	ParserState ParseCipstatus(DelimParser& parser);
+	ParserState ParseCipstatusSingleConnection(DelimParser& parser);
+	bool ParseConnectionInfo(DelimParser& parser, ConnectionInfo& connectionInfo);
+	ParserState ParseCipRxGetRead(DelimParser& parser);
+	ParserState ParseCipRxGetLength(DelimParser& parser);
+	ParserState ParseCsq(DelimParser& parser);
+	ParserState ParseCbc(DelimParser& parser);
+	ParserState ParseCifsr(DelimParser& parser);
+	ParserState ParseClcc(DelimParser& parser);
+	ParserState ParseCipstart(DelimParser& parser);
+	ParserState ParseCipshut(DelimParser& parser);
+	ParserState ParseCipclose(DelimParser& parser);
+	ParserState ParseCops(DelimParser& parser);
+	ParserState ParseGsn(DelimParser& parser);
+	ParserState ParseCusd(DelimParser& parser);
+	ParserState ParseCipmux(DelimParser& parser);
+	ParserState ParseCipQsendQuery(DelimParser& parser);
+	ParserState ParseCipRxGet(DelimParser& parser);
+	ParserState ParseCipSend(DelimParser& parser);
+	ParserState ParseCipSendQuery(DelimParser& parser);
+	ParserState ParseCipAck(DelimParser& parser);
+	ParserState ParseCreg(DelimParser& parser);
 	int StateTransition(char c);
+	bool IsWaitingForPrompt();
+	bool IsCipsendEcho(char c);
+	uint8_t CipsendByte(uint16_t position);
+	void AppendPayload(const uint8_t* data, size_t length);
 	bool _garbageOnSerialDetected;
-	Stream& _serial;
+	// response of timed out command may still arrive, lines are discarded until echo of next command
+	bool _staleResponse;
+	// AT+CIPSTATUS lines after OK, 0 until STATE line
+	uint8_t _cipstatusLines;
 	SequenceDetector _promptSequenceDetector;
 	AtCommand _currentCommand;
 	FixedStringBase& _currentCommandStr;
 public:
-	SimcomResponseParser(ParserContext &parserContext, GsmLogger &logger,Stream& serial, FixedStringBase &currentCommandStr);
+	typedef ParserState(SimcomResponseParser::*ResponseHandler)(DelimParser& parser);
+	struct ResponseDescriptor
+	{
+		// response line prefix in program memory, handler gets parser positioned after it
+		const char *Prefix;
+		ResponseHandler Handler;
+		// plain OK completes command that didn't return any data line
+		bool CompletesOnOk;
+	};
+	static const ResponseDescriptor ResponseDescriptors[];
+
+	SimcomResponseParser(ParserContext &parserContext, GsmLogger &logger, FixedStringBase &currentCommandStr);
 	AtResultType GetAtResultType();
+	bool IsWaitingForEcho()
+	{
+		return _state == ParserState::WaitingForEcho;
+	}
+	bool IsDiscardingResponse()
+	{
+		return _staleResponse;
+	}
 	volatile bool commandReady;
 	void SetCommandType(AtCommand commandType, bool expectEcho = true);
 	void FeedChar(char c);	
+	size_t FeedChars(const uint8_t* data, size_t length);
+	size_t GetPayloadBuffer(uint8_t*& destination);
+	void PayloadReceived(size_t length);
+	void DiscardResponse();
 	void OnDataReceived(DataReceivedCallback onDataReceived);
+	void OnUnsolicited(UnsolicitedType type, UnsolicitedCallback callback, void* state);
+	void OnConnectionEvent(UnsolicitedCallback callback, void* state);
+	void DispatchQueuedUnsolicited();
 	bool GarbageOnSerialDetected();
 	void ResetUartGarbageDetected();
 };
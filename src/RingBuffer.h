@@ -0,0 +1,103 @@
+#ifndef _RING_BUFFER_H
+#define _RING_BUFFER_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+Byte FIFO of fixed capacity. Besides copying Write/Read it exposes contiguous spans,
+so CIPSEND payload and CIPRXGET data can go straight from/to buffer memory
+*/
+template<uint16_t Capacity>
+class RingBuffer
+{
+	uint8_t _data[Capacity];
+	uint16_t _head;
+	uint16_t _count;
+public:
+	RingBuffer() :
+		_head(0),
+		_count(0)
+	{
+	}
+	uint16_t Available() const
+	{
+		return _count;
+	}
+	uint16_t Free() const
+	{
+		return Capacity - _count;
+	}
+	void Clear()
+	{
+		_head = 0;
+		_count = 0;
+	}
+	int Peek() const
+	{
+		return _count == 0 ? -1 : _data[_head];
+	}
+	/* bytes from head up to end of storage or end of data */
+	uint16_t ReadableSpan(const uint8_t *&data) const
+	{
+		data = _data + _head;
+		const uint16_t toEnd = Capacity - _head;
+		return _count < toEnd ? _count : toEnd;
+	}
+	void Consume(uint16_t length)
+	{
+		_head = (_head + length) % Capacity;
+		_count -= length;
+	}
+	/* free bytes after tail up to end of storage, filled by caller and then committed */
+	uint16_t WritableSpan(uint8_t *&data)
+	{
+		const uint16_t tail = (_head + _count) % Capacity;
+		data = _data + tail;
+		const uint16_t toEnd = Capacity - tail;
+		return Free() < toEnd ? Free() : toEnd;
+	}
+	void Commit(uint16_t length)
+	{
+		_count += length;
+	}
+	/* returns number of bytes stored, less than length when buffer is full */
+	size_t Write(const uint8_t *data, size_t length)
+	{
+		size_t written = 0;
+		while (written < length)
+		{
+			uint8_t *span;
+			const size_t spanLength = WritableSpan(span);
+			if (spanLength == 0)
+			{
+				break;
+			}
+			const size_t chunk = length - written < spanLength ? length - written : spanLength;
+			memcpy(span, data + written, chunk);
+			Commit(chunk);
+			written += chunk;
+		}
+		return written;
+	}
+	size_t Read(uint8_t *data, size_t length)
+	{
+		size_t read = 0;
+		while (read < length)
+		{
+			const uint8_t *span;
+			const size_t spanLength = ReadableSpan(span);
+			if (spanLength == 0)
+			{
+				break;
+			}
+			const size_t chunk = length - read < spanLength ? length - read : spanLength;
+			memcpy(data + read, span, chunk);
+			Consume(chunk);
+			read += chunk;
+		}
+		return read;
+	}
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include "S900Socket.h"
+
+S900Socket::S900Socket(SimcomAtCommands &gsm, uint8_t mux) :
+	_gsm(gsm),
+	_mux(mux),
+	_state(ConnectionState::Initial),
+	_sendInProgress(false),
+	_sendLength(0),
+	_txConfirmed(0),
+	_txLength(0),
+	_txLengthQueries(0),
+	_readInProgress(false),
+	_lastReadFailed(false),
+	_lastReadAt(0),
+	_connectTimeout(CONNECT_TIMEOUT)
+{
+	_gsm.AttachSocket(*this);
+}
+S900Socket::~S900Socket()
+{
+	_gsm.DetachSocket(*this);
+}
+
+int S900Socket::connect(IPAddress ip, uint16_t port)
+{
+	FixedString20 address;
+	address.appendFormat(F("%d.%d.%d.%d"), ip[0], ip[1], ip[2], ip[3]);
+	return connect(address.c_str(), port);
+}
+/*
+blocks until CONNECT OK/CONNECT FAIL of the mux, at most SetConnectTimeout() time and a status query.
+Returns 1 when connected like other Arduino clients
+*/
+int S900Socket::connect(const char *host, uint16_t port)
+{
+	if (_mux >= MAX_CONNECTIONS)
+	{
+		return 0;
+	}
+	// read or send of previous connection may still be queued and write into buffers
+	_gsm.WaitForAsyncCommands();
+	_rxBuffer.Clear();
+	_txBuffer.Clear();
+	// AT+CIPACK counts from CIPSTART
+	_txConfirmed = 0;
+	_state = ConnectionState::Connecting;
+	if (_gsm.BeginConnect(ProtocolType::Tcp, _mux, host, port) != AtResultType::Success)
+	{
+		_state = ConnectionState::Closed;
+		return 0;
+	}
+	const auto connecting = [](S900Socket &socket) { return socket._state == ConnectionState::Connecting; };
+	if (!WaitWhile(connecting, _connectTimeout))
+	{
+		// result URC may have been lost, modem knows
+		ConnectionInfo info;
+		if (_gsm.GetConnectionInfo(_mux, info) == AtResultType::Success)
+		{
+			_state = info.State;
+		}
+		if (_state == ConnectionState::Connecting)
+		{
+			// late CONNECT OK must not revive connection caller gave up
+			Abort();
+		}
+	}
+	return _state == ConnectionState::Connected ? 1 : 0;
+}
+
+size_t S900Socket::write(uint8_t c)
+{
+	return write(&c, 1);
+}
+/* copies data to TX buffer, blocks only while buffer is full */
+size_t S900Socket::write(const uint8_t *buffer, size_t size)
+{
+	size_t written = 0;
+	auto lastProgressAt = _gsm.Clock().Millis();
+	while (written < size && _state == ConnectionState::Connected)
+	{
+		const auto stored = _txBuffer.Write(buffer + written, size - written);
+		written += stored;
+		if (stored > 0)
+		{
+			lastProgressAt = _gsm.Clock().Millis();
+		}
+		else if (_gsm.Clock().Millis() - lastProgressAt >= SOCKET_WRITE_TIMEOUT)
+		{
+			break;
+		}
+		if (written < size)
+		{
+			_gsm.Poll();
+			_gsm.Clock().Idle();
+		}
+	}
+	return written;
+}
+
+int S900Socket::available()
+{
+	_gsm.Poll();
+	return _rxBuffer.Available();
+}
+int S900Socket::read()
+{
+	uint8_t c;
+	return read(&c, 1) == 1 ? c : -1;
+}
+int S900Socket::read(uint8_t *buffer, size_t size)
+{
+	_gsm.Poll();
+	if (_rxBuffer.Available() == 0)
+	{
+		return -1;
+	}
+	return static_cast<int>(_rxBuffer.Read(buffer, size));
+}
+int S900Socket::peek()
+{
+	_gsm.Poll();
+	return _rxBuffer.Peek();
+}
+/* waits until modem accepted everything written */
+void S900Socket::flush()
+{
+	const auto sending = [](S900Socket &socket)
+	{
+		return socket._state == ConnectionState::Connected && (socket._sendInProgress || socket._txBuffer.Available() > 0);
+	};
+	WaitWhile(sending, SOCKET_WRITE_TIMEOUT);
+}
+void S900Socket::stop()
+{
+	flush();
+	if (_state == ConnectionState::Connected || _state == ConnectionState::Connecting)
+	{
+		_gsm.CloseConnection(_mux);
+	}
+	_state = ConnectionState::Closed;
+	_gsm.WaitForAsyncCommands();
+	_rxBuffer.Clear();
+	_txBuffer.Clear();
+}
+/* connection closed by remote side stays readable until RX buffer is drained */
+uint8_t S900Socket::connected()
+{
+	_gsm.Poll();
+	return _state == ConnectionState::Connected || _rxBuffer.Available() > 0;
+}
+S900Socket::operator bool()
+{
+	return connected();
+}
+
+/* returns false on timeout */
+bool S900Socket::WaitWhile(bool (*condition)(S900Socket &socket), unsigned long timeout)
+{
+	const auto start = _gsm.Clock().Millis();
+	while (condition(*this))
+	{
+		if (_gsm.Clock().Millis() - start >= timeout)
+		{
+			return false;
+		}
+		_gsm.Poll();
+		_gsm.Clock().Idle();
+	}
+	return true;
+}
+
+/*
+called by engine when no command is running, starts at most one async command:
+CIPSEND of buffered data or CIPRXGET read into free RX space. Returns true if command was queued
+*/
+bool S900Socket::Service()
+{
+	if (_state != ConnectionState::Connected)
+	{
+		return false;
+	}
+	if (!_sendInProgress && _txBuffer.Available() > 0)
+	{
+		const uint8_t *data;
+		uint16_t length = _txBuffer.ReadableSpan(data);
+		if (length > CIPSEND_MAX_LENGTH)
+		{
+			length = CIPSEND_MAX_LENGTH;
+		}
+		if (length > _gsm.SendWindowLeft(_mux))
+		{
+			length = _gsm.SendWindowLeft(_mux);
+		}
+		if (length > 0 && _gsm.SendAsync(_mux, data, length, OnSent, this))
+		{
+			_sendInProgress = true;
+			_sendLength = length;
+			return true;
+		}
+		if (length == 0 && _gsm.RefreshSendWindow())
+		{
+			return true;
+		}
+	}
+	const auto now = _gsm.Clock().Millis();
+	const bool dataPending = _gsm.IsDataPending(_mux) && !_lastReadFailed;
+	if (!_readInProgress && _rxBuffer.Free() > 0 && (dataPending || now - _lastReadAt >= SOCKET_POLL_INTERVAL))
+	{
+		uint8_t *buffer;
+		uint16_t capacity = _rxBuffer.WritableSpan(buffer);
+		if (capacity > CIPRXGET_MAX_LENGTH)
+		{
+			capacity = CIPRXGET_MAX_LENGTH;
+		}
+		if (_gsm.ReadAsync(_mux, buffer, capacity, OnRead, this))
+		{
+			_readInProgress = true;
+			_lastReadAt = now;
+			return true;
+		}
+	}
+	return false;
+}
+void S900Socket::OnSent(uint8_t, AtResultType result, uint16_t sentBytes, void *state)
+{
+	auto socket = static_cast<S900Socket*>(state);
+	socket->_txBuffer.Consume(sentBytes);
+	socket->_txConfirmed += sentBytes;
+	socket->_sendLength -= sentBytes;
+	if ((result == AtResultType::Success && socket->_sendLength == 0) || socket->_state != ConnectionState::Connected)
+	{
+		socket->_sendInProgress = false;
+		return;
+	}
+	// modem may have taken more than lost or garbled response said, only the rest is sent again
+	socket->_txLengthQueries = 0;
+	if (!socket->QuerySentDataLength())
+	{
+		socket->_sendInProgress = false;
+		socket->Abort();
+	}
+}
+bool S900Socket::QuerySentDataLength()
+{
+	_txLengthQueries++;
+	return _gsm.GetSentDataLengthAsync(_mux, _txLength, OnSentDataLength, this);
+}
+void S900Socket::OnSentDataLength(AtCommand, AtResultType result, void *state)
+{
+	auto socket = static_cast<S900Socket*>(state);
+	if (socket->_state != ConnectionState::Connected)
+	{
+		socket->_sendInProgress = false;
+		return;
+	}
+	// query changes nothing in modem, it is repeated on lost response or garbled counter
+	if (result != AtResultType::Success || socket->_txLength < socket->_txConfirmed)
+	{
+		if (socket->_txLengthQueries > SEND_ALL_MAX_RETRIES || !socket->QuerySentDataLength())
+		{
+			socket->_sendInProgress = false;
+			socket->Abort();
+		}
+		return;
+	}
+	const uint32_t taken = socket->_txLength - socket->_txConfirmed;
+	const uint16_t sentBytes = taken < socket->_sendLength ? static_cast<uint16_t>(taken) : socket->_sendLength;
+	socket->_txBuffer.Consume(sentBytes);
+	socket->_txConfirmed += sentBytes;
+	socket->_sendInProgress = false;
+}
+/* without knowing what modem took, data would be lost or repeated, connection is closed instead */
+void S900Socket::Abort()
+{
+	if (_state == ConnectionState::Connected || _state == ConnectionState::Connecting)
+	{
+		_gsm.CloseConnectionAsync(_mux);
+	}
+	_state = ConnectionState::Closed;
+}
+void S900Socket::OnRead(uint8_t, AtResultType result, uint16_t readBytes, uint16_t, void *state)
+{
+	auto socket = static_cast<S900Socket*>(state);
+	socket->_readInProgress = false;
+	socket->_rxBuffer.Commit(readBytes);
+	socket->_lastReadFailed = result != AtResultType::Success;
+}
+void S900Socket::ConnectionEvent(UnsolicitedResult &result)
+{
+	switch (result.Type)
+	{
+	case UnsolicitedType::ConnectOk:
+	case UnsolicitedType::AlreadyConnected:
+		// result of connect() that gave up is ignored
+		if (_state == ConnectionState::Connecting)
+		{
+			_state = ConnectionState::Connected;
+		}
+		break;
+	case UnsolicitedType::ConnectFail:
+	case UnsolicitedType::ConnectionClosed:
+		_state = ConnectionState::Closed;
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef _S900_SOCKET_H
+#define _S900_SOCKET_H
+
+#include <Client.h>
+#include "SimcomAtCommands.h"
+#include "RingBuffer.h"
+
+/*
+Arduino Client over one connection of AT+CIPMUX=1 mode, modem must be in manual receive mode (AT+CIPRXGET=1).
+Written data is queued in TX buffer and data announced by +CIPRXGET: 1,<mux> is read ahead into RX buffer by SimcomAtCommands::Poll()
+when no other command is running, so read/write/available work on RAM and only drive the engine
+*/
+class S900Socket : public Client
+{
+	friend class SimcomAtCommands;
+
+	SimcomAtCommands &_gsm;
+	uint8_t _mux;
+	ConnectionState _state;
+	RingBuffer<SOCKET_RX_BUFFER_SIZE> _rxBuffer;
+	RingBuffer<SOCKET_TX_BUFFER_SIZE> _txBuffer;
+	bool _sendInProgress;
+	// bytes of send in progress not confirmed yet
+	uint16_t _sendLength;
+	// bytes modem confirmed since connect and txlen of AT+CIPACK that checks failed send
+	uint32_t _txConfirmed;
+	uint32_t _txLength;
+	uint8_t _txLengthQueries;
+	bool _readInProgress;
+	// failed read is not repeated on pending notification, only after poll interval
+	bool _lastReadFailed;
+	unsigned long _lastReadAt;
+	unsigned long _connectTimeout;
+
+	bool Service();
+	void ConnectionEvent(UnsolicitedResult &result);
+	bool WaitWhile(bool (*condition)(S900Socket &socket), unsigned long timeout);
+	bool QuerySentDataLength();
+	void Abort();
+	static void OnSent(uint8_t mux, AtResultType result, uint16_t sentBytes, void *state);
+	static void OnSentDataLength(AtCommand command, AtResultType result, void *state);
+	static void OnRead(uint8_t mux, AtResultType result, uint16_t readBytes, uint16_t dataLeft, void *state);
+public:
+	/* mux below MAX_CONNECTIONS, socket of other mux is not attached to engine and never connects */
+	S900Socket(SimcomAtCommands &gsm, uint8_t mux);
+	/* doesn't wait for modem, queued commands of socket are dropped and open connection is closed */
+	~S900Socket();
+	uint8_t Mux()
+	{
+		return _mux;
+	}
+	ConnectionState State()
+	{
+		return _state;
+	}
+	/* longest time connect() blocks waiting for result of CIPSTART, CONNECT_TIMEOUT by default */
+	void SetConnectTimeout(unsigned long timeout)
+	{
+		_connectTimeout = timeout;
+	}
+
+	int connect(IPAddress ip, uint16_t port) override;
+	int connect(const char *host, uint16_t port) override;
+	size_t write(uint8_t c) override;
+	size_t write(const uint8_t *buffer, size_t size) override;
+	int available() override;
+	int read() override;
+	int read(uint8_t *buffer, size_t size) override;
+	int peek() override;
+	void flush() override;
+	void stop() override;
+	uint8_t connected() override;
+	operator bool() override;
+	using Print::write;
+};
+
+#endif
@@ -1,13 +1,70 @@
 #include "SimcomAtCommands.h"
+#include "S900Socket.h"
 #include "GsmLibHelpers.h"
 
+// written instead of CIPSEND payload that is gone, modem waits for announced length
+static const uint8_t CipsendFiller[SERIAL_WRITE_CHUNK_SIZE] = {};
+
 SimcomAtCommands::SimcomAtCommands(Stream& serial, UpdateBaudRateCallback updateBaudRateCallback) :
 _serial(serial),
-_parser(_parserContext, _logger, serial, _currentCommand),
+_parser(_parserContext, _logger, _currentCommand),
+_clock(&ArduinoClock::Instance),
+_useEcho(true),
+_traceRecorder(nullptr),
 IsAsync(false)
 {
 	_updateBaudRateCallback = updateBaudRateCallback;
 	_currentBaudRate = 0;
+	_readBufferPosition = 0;
+	_readBufferLength = 0;
+	_asyncQueueHead = 0;
+	_asyncQueueCount = 0;
+	_commandInProgress = false;
+	_commandType = AtCommand::Generic;
+	_commandStart = 0;
+	_commandTimeoutStart = 0;
+	_cipsendPaddingLeft = 0;
+	_cipsendPaddingMux = 0;
+	_cipsendPaddingStart = 0;
+	_commandTimeout = AT_DEFAULT_TIMEOUT;
+	_commandCallback = nullptr;
+	_commandCallbackState = nullptr;
+	_commandPreviousOutput = nullptr;
+	_lastCommandResult = AtResultType::Timeout;
+	_commandSendCount = 0;
+	_commandSentBytes = 0;
+	for (auto &send : _sendQueue)
+	{
+		send.InUse = false;
+	}
+	for (uint8_t mux = 0; mux < MAX_CONNECTIONS; mux++)
+	{
+		_sendWindows[mux] = CIPSEND_MAX_LENGTH;
+		_sendsInFlight[mux] = 0;
+	}
+	_parserContext.SendWindows = _sendWindows;
+	_sendWindowQueryQueued = false;
+	_sendWindowQueriedAt = 0;
+	_pendingRead.InUse = false;
+	for (uint8_t mux = 0; mux < MAX_CONNECTIONS; mux++)
+	{
+		auto &connection = _connections[mux];
+		connection.Owner = this;
+		connection.Mux = mux;
+		connection.State = ConnectionState::Initial;
+		connection.StartedAt = 0;
+		connection.Callback = nullptr;
+		connection.CallbackState = nullptr;
+		connection.ResultReady = false;
+		connection.Result = AtResultType::Timeout;
+	}
+	for (auto &socket : _sockets)
+	{
+		socket = nullptr;
+	}
+	_nextSocket = 0;
+	_waitingForQueue = false;
+	_parser.OnConnectionEvent(OnConnectionEvent, this);
 }
 AtResultType SimcomAtCommands::GetSimStatus(SimState &simStatus)
 {
@@ -33,49 +90,715 @@ AtResultType SimcomAtCommands::GetRegistrationStatus(GsmRegistrationState& regis
 }
 AtResultType SimcomAtCommands::GenericAt(int timeout, const __FlashStringHelper* command, ...)
 {	
-	_parser.SetCommandType(AtCommand::Generic);
 	va_list argptr;
 	va_start(argptr, command);
-
-	FixedString200 buffer;
-	buffer.appendFormatV(command, argptr);
-	_logger.LogAt(F(" => %s"), buffer.c_str());
-	_currentCommand = buffer;
-	_serial.println(buffer.c_str());
-
-	const auto result = PopCommandResult(timeout);
+	SendAtV(AtCommand::Generic, true, command, argptr);
 	va_end(argptr);	
-	return result;
+
+	return PopCommandResult(timeout);
 }
 void SimcomAtCommands::SendAt_P(AtCommand commandType, const __FlashStringHelper* command, ...)
 {
-	_parser.SetCommandType(commandType);
-
 	va_list argptr;
 	va_start(argptr, command);
-
-	FixedString200 buffer;
-	buffer.appendFormatV(command, argptr);
-	_currentCommand = buffer;
-	_logger.LogAt(F(" => %s"), buffer.c_str());
-	_serial.println(buffer.c_str());
-
+	SendAtV(commandType, _parserContext.EchoEnabled, command, argptr);
 	va_end(argptr);
 }
 void SimcomAtCommands::SendAt_P(AtCommand commandType, bool expectEcho, const __FlashStringHelper* command, ...)
 {
-	_parser.SetCommandType(commandType, expectEcho);
-
 	va_list argptr;
 	va_start(argptr, command);
+	SendAtV(commandType, expectEcho, command, argptr);
+	va_end(argptr);
+}
+/* 
+Blocking commands share the serial port with queued async commands, 
+so pending async commands are completed before the blocking one is sent
+*/
+void SimcomAtCommands::SendAtV(AtCommand commandType, bool expectEcho, const __FlashStringHelper* command, va_list args)
+{
+	// events of previous blocking command, its caller already has the result
+	DispatchEvents();
+	WaitForAsyncCommands();
 
 	FixedString200 buffer;
-	buffer.appendFormatV(command, argptr);
-	_currentCommand = buffer;
-	_logger.LogAt(F(" => %s"), buffer.c_str());
-	_serial.println(buffer.c_str());
+	buffer.appendFormatV(command, args);
+	StartCommand(commandType, expectEcho, buffer.c_str());
+}
+void SimcomAtCommands::StartCommand(AtCommand commandType, bool expectEcho, const char *command)
+{
+	if (_parser.IsDiscardingResponse())
+	{
+		// bytes received before command is sent can't be its response
+		ReadSerial();
+	}
+	_parser.SetCommandType(commandType, expectEcho);
+	_currentCommand = command;
+	_logger.LogAt(F(" => %s"), command);
+	_serial.println(command);
+	TraceSerial(UartTraceDirection::Write, command, strlen(command));
+	TraceSerial(UartTraceDirection::Write, "\r\n", 2);
+
+	_commandType = commandType;
+	_commandInProgress = true;
+	_commandStart = _clock->Millis();
+	_commandTimeoutStart = _commandStart;
+	_commandTimeout = AT_DEFAULT_TIMEOUT;
+	_commandCallback = nullptr;
+	_commandCallbackState = nullptr;
+}
+bool SimcomAtCommands::EnqueueAt_P(AtCommand commandType, int timeout, void *output, AtCommandCallback callback, void *state, const __FlashStringHelper* command, ...)
+{
+	if (_asyncQueueCount == ASYNC_COMMAND_QUEUE_SIZE)
+	{
+		_logger.Log(F("Async command queue full"));
+		return false;
+	}
+	auto &entry = _asyncQueue[(_asyncQueueHead + _asyncQueueCount) % ASYNC_COMMAND_QUEUE_SIZE];
+	entry.Command = commandType;
+	entry.Timeout = timeout;
+	entry.Output = output;
+	entry.Callback = callback;
+	entry.CallbackState = state;
+
+	entry.CommandStr.clear();
+	// queued sends are formatted when started, merged with sends queued after them
+	if (command != nullptr)
+	{
+		va_list argptr;
+		va_start(argptr, command);
+		entry.CommandStr.appendFormatV(command, argptr);
+		va_end(argptr);
+	}
 
-	va_end(argptr);
+	_asyncQueueCount++;
+	return true;
+}
+void SimcomAtCommands::StartNextAsyncCommand()
+{
+	auto &entry = _asyncQueue[_asyncQueueHead];
+	_asyncQueueHead = (_asyncQueueHead + 1) % ASYNC_COMMAND_QUEUE_SIZE;
+	_asyncQueueCount--;
+
+	if (entry.Command == AtCommand::CipSend)
+	{
+		StartQueuedSends(static_cast<PendingSend*>(entry.Output), entry.Timeout);
+		return;
+	}
+	auto previousOutput = BindOutput(entry.Command, entry.Output);
+	StartCommand(entry.Command, _parserContext.EchoEnabled, entry.CommandStr.c_str());
+	_commandPreviousOutput = previousOutput;
+	_commandTimeout = static_cast<int>(_timeouts.Timeout(entry.Command, _currentCommand.c_str(), entry.Timeout));
+	_commandCallback = entry.Callback;
+	_commandCallbackState = entry.CallbackState;
+}
+/*
+starts CIPSEND of queued send together with sends of same mux queued right after it,
+modem gets them as one payload so prompt and DATA ACCEPT round trip is paid once
+*/
+void SimcomAtCommands::StartQueuedSends(PendingSend *first, int timeout)
+{
+	_commandSends[0] = first;
+	_commandSegments[0].Data = first->Data;
+	_commandSegments[0].Length = first->Length;
+	_commandSendCount = 1;
+	uint16_t length = first->Length;
+	while (_asyncQueueCount > 0 && _commandSendCount < SEND_QUEUE_SIZE)
+	{
+		auto &next = _asyncQueue[_asyncQueueHead];
+		auto send = static_cast<PendingSend*>(next.Output);
+		if (next.Command != AtCommand::CipSend || send->Mux != first->Mux || length + send->Length > CIPSEND_MAX_LENGTH)
+		{
+			break;
+		}
+		_asyncQueueHead = (_asyncQueueHead + 1) % ASYNC_COMMAND_QUEUE_SIZE;
+		_asyncQueueCount--;
+		_commandSends[_commandSendCount] = send;
+		_commandSegments[_commandSendCount].Data = send->Data;
+		_commandSegments[_commandSendCount].Length = send->Length;
+		_commandSendCount++;
+		length += send->Length;
+	}
+	_commandSentBytes = 0;
+	_parserContext.CipsendSegments = _commandSegments;
+	_parserContext.CipsendSegmentCount = _commandSendCount;
+	_parserContext.CipsendMux = first->Mux;
+	_parserContext.CipsendLength = length;
+	_parserContext.CipsendSentBytes = &_commandSentBytes;
+	_parserContext.CipsendState = CipsendStateType::WaitingForPrompt;
+
+	FixedString20 command;
+	command.appendFormat(F("AT+CIPSEND=%d,%d"), first->Mux, length);
+	StartCommand(AtCommand::CipSend, _parserContext.EchoEnabled, command.c_str());
+	_commandTimeout = static_cast<int>(_timeouts.Timeout(AtCommand::CipSend, _currentCommand.c_str(), timeout));
+}
+/* 
+points parser context at the output variable of queued command, 
+returns previous output so it can be restored for blocking caller waiting for the queue
+*/
+void* SimcomAtCommands::BindOutput(AtCommand commandType, void *output)
+{
+	void *previousOutput = nullptr;
+	if (output == nullptr)
+	{
+		return previousOutput;
+	}
+	switch (commandType)
+	{
+	case AtCommand::Csq:
+		previousOutput = _parserContext.CsqSignalQuality;
+		_parserContext.CsqSignalQuality = static_cast<int16_t*>(output);
+		break;
+	case AtCommand::Cbc:
+		previousOutput = _parserContext.BatteryInfo;
+		_parserContext.BatteryInfo = static_cast<BatteryStatus*>(output);
+		break;
+	case AtCommand::Cipstatus:
+		previousOutput = _parserContext.IpState;
+		_parserContext.IpState = static_cast<SimcomIpState*>(output);
+		break;
+	case AtCommand::CipAck:
+		previousOutput = _parserContext.CipAckTxLength;
+		_parserContext.CipAckTxLength = static_cast<uint32_t*>(output);
+		break;
+	case AtCommand::CipRxGetRead:
+	{
+		// blocking reads set their buffer after async commands are done, nothing to restore
+		auto read = static_cast<PendingRead*>(output);
+		_parserContext.CipRxGetData = read->Buffer;
+		_parserContext.CipRxGetDataCapacity = read->Capacity;
+		_parserContext.CipRxGetDataLength = 0;
+		_parserContext.CipRxGetDataLeft = 0;
+		break;
+	}
+	default:
+		break;
+	}
+	return previousOutput;
+}
+void SimcomAtCommands::CompleteCommand()
+{
+	const auto commandResult = _parser.GetAtResultType();
+	const auto elapsedMs = _clock->Millis() - _commandStart;	
+	_logger.LogAt(F("    -- %d ms --"), elapsedMs);
+	if (commandResult == AtResultType::Timeout)
+	{
+		_logger.Log(F("                      --- !!! '%s' - TIMEOUT!!! ---      "), _currentCommand.c_str(), elapsedMs);
+		_parser.DiscardResponse();
+	}
+	if (commandResult == AtResultType::Error)
+	{
+		_logger.Log(F("                      --- !!! '%s' - ERROR!!! ---      "), _currentCommand.c_str(), elapsedMs);
+	}
+	_commandStats[static_cast<uint8_t>(_commandType)].Record(commandResult, elapsedMs);
+	_timeouts.Record(_commandType, _currentCommand.c_str(), commandResult, elapsedMs);
+	_commandInProgress = false;
+	_lastCommandResult = commandResult;
+	BindOutput(_commandType, _commandPreviousOutput);
+	_commandPreviousOutput = nullptr;
+	if (_commandSendCount > 0)
+	{
+		CompleteSend(commandResult);
+	}
+
+	if (_commandCallback != nullptr)
+	{
+		auto callback = _commandCallback;
+		_commandCallback = nullptr;
+		callback(_commandType, commandResult, _commandCallbackState);
+	}
+}
+void SimcomAtCommands::CompleteSend(AtResultType result)
+{
+	auto acceptedBytes = result == AtResultType::Success ? _commandSentBytes : 0;
+	const auto sendCount = _commandSendCount;
+	_commandSendCount = 0;
+	for (uint8_t i = 0; i < sendCount; i++)
+	{
+		auto send = _commandSends[i];
+		const auto sentBytes = acceptedBytes < send->Length ? acceptedBytes : send->Length;
+		acceptedBytes -= sentBytes;
+		_sendsInFlight[send->Mux] -= send->Length;
+		send->InUse = false;
+		if (send->Callback != nullptr)
+		{
+			send->Callback(send->Mux, result, sentBytes, send->CallbackState);
+		}
+	}
+	if (sendCount > 0 && SendWindowLeft(_parserContext.CipsendMux) < CIPSEND_MAX_LENGTH)
+	{
+		RefreshSendWindow();
+	}
+}
+/* queues AT+CIPSEND? unless one is queued or was queued less than SEND_ALL_RETRY_DELAY ago */
+bool SimcomAtCommands::RefreshSendWindow()
+{
+	const auto now = _clock->Millis();
+	if (_sendWindowQueryQueued || now - _sendWindowQueriedAt < (unsigned long)SEND_ALL_RETRY_DELAY)
+	{
+		return false;
+	}
+	if (!EnqueueAt_P(AtCommand::CipSendQuery, AT_DEFAULT_TIMEOUT, nullptr, OnSendWindowQueried, this, F("AT+CIPSEND?")))
+	{
+		return false;
+	}
+	_sendWindowQueryQueued = true;
+	_sendWindowQueriedAt = now;
+	return true;
+}
+void SimcomAtCommands::OnSendWindowQueried(AtCommand, AtResultType, void *state)
+{
+	static_cast<SimcomAtCommands*>(state)->_sendWindowQueryQueued = false;
+}
+void SimcomAtCommands::OnReadCompleted(AtCommand, AtResultType result, void *state)
+{
+	auto gsm = static_cast<SimcomAtCommands*>(state);
+	auto &read = gsm->_pendingRead;
+	auto &context = gsm->_parserContext;
+	context.CipRxGetData = nullptr;
+	read.InUse = false;
+	if (read.Callback != nullptr)
+	{
+		const auto success = result == AtResultType::Success;
+		read.Callback(read.Mux, result, success ? context.CipRxGetDataLength : 0, success ? context.CipRxGetDataLeft : 0, read.CallbackState);
+	}
+}
+void SimcomAtCommands::OnConnectionEvent(UnsolicitedResult &result, void *state)
+{
+	auto gsm = static_cast<SimcomAtCommands*>(state);
+	if (result.Mux >= MAX_CONNECTIONS)
+	{
+		return;
+	}
+	switch (result.Type)
+	{
+	case UnsolicitedType::ConnectOk:
+	case UnsolicitedType::AlreadyConnected:
+		gsm->CompleteConnect(result.Mux, AtResultType::Success);
+		break;
+	case UnsolicitedType::ConnectFail:
+		gsm->CompleteConnect(result.Mux, AtResultType::Error);
+		break;
+	case UnsolicitedType::ConnectionClosed:
+		gsm->_connections[result.Mux].State = ConnectionState::Closed;
+		break;
+	default:
+		break;
+	}
+	if (gsm->_sockets[result.Mux] != nullptr)
+	{
+		gsm->_sockets[result.Mux]->ConnectionEvent(result);
+	}
+}
+/* OK of CIPSTART only starts connecting, failure ends it right away */
+void SimcomAtCommands::OnCipstartCompleted(AtCommand, AtResultType result, void *state)
+{
+	auto connection = static_cast<TrackedConnection*>(state);
+	if (result != AtResultType::Success)
+	{
+		connection->Owner->CompleteConnect(connection->Mux, result);
+	}
+}
+/* may be called while response is parsed, callback is only latched and called by DispatchEvents() */
+void SimcomAtCommands::CompleteConnect(uint8_t mux, AtResultType result)
+{
+	auto &connection = _connections[mux];
+	connection.State = result == AtResultType::Success ? ConnectionState::Connected : ConnectionState::Closed;
+	if (connection.Callback != nullptr && !connection.ResultReady)
+	{
+		connection.ResultReady = true;
+		connection.Result = result;
+	}
+}
+/* 
+runs connect callbacks and URC handlers collected while responses were parsed, 
+called only when no blocking caller waits for result of current command, so they may send commands
+*/
+void SimcomAtCommands::DispatchEvents()
+{
+	for (uint8_t mux = 0; mux < MAX_CONNECTIONS; mux++)
+	{
+		auto &connection = _connections[mux];
+		if (!connection.ResultReady)
+		{
+			continue;
+		}
+		auto callback = connection.Callback;
+		connection.ResultReady = false;
+		connection.Callback = nullptr;
+		callback(mux, connection.Result, connection.CallbackState);
+	}
+	_parser.DispatchQueuedUnsolicited();
+}
+void SimcomAtCommands::CheckConnectTimeouts()
+{
+	const auto now = _clock->Millis();
+	for (uint8_t mux = 0; mux < MAX_CONNECTIONS; mux++)
+	{
+		const auto &connection = _connections[mux];
+		if (connection.State == ConnectionState::Connecting && now - connection.StartedAt >= (unsigned long)CONNECT_TIMEOUT)
+		{
+			_logger.Log(F("Connect of mux %d timed out"), mux);
+			CompleteConnect(mux, AtResultType::Timeout);
+		}
+	}
+}
+void SimcomAtCommands::AttachSocket(S900Socket &socket)
+{
+	if (socket.Mux() >= MAX_CONNECTIONS)
+	{
+		_logger.Log(F("Socket mux %d out of range"), socket.Mux());
+		return;
+	}
+	_sockets[socket.Mux()] = &socket;
+}
+void SimcomAtCommands::DetachSocket(S900Socket &socket)
+{
+	if (socket.Mux() >= MAX_CONNECTIONS)
+	{
+		return;
+	}
+	auto &slot = _sockets[socket.Mux()];
+	if (slot != &socket)
+	{
+		return;
+	}
+	slot = nullptr;
+	CancelSocketCommands(&socket);
+	// data buffered in socket is gone, remote side must not take the rest as complete
+	if (socket.State() == ConnectionState::Connected || socket.State() == ConnectionState::Connecting)
+	{
+		CloseConnectionAsync(socket.Mux());
+	}
+}
+/*
+drops queued sends, reads and queries of socket, command in progress no longer calls it back
+or touches its buffers. Doesn't wait, socket may be destroyed right after
+*/
+void SimcomAtCommands::CancelSocketCommands(void *socket)
+{
+	uint8_t kept = 0;
+	for (uint8_t i = 0; i < _asyncQueueCount; i++)
+	{
+		auto &entry = _asyncQueue[(_asyncQueueHead + i) % ASYNC_COMMAND_QUEUE_SIZE];
+		auto send = static_cast<PendingSend*>(entry.Output);
+		if (entry.Command == AtCommand::CipSend && send->CallbackState == socket)
+		{
+			_sendsInFlight[send->Mux] -= send->Length;
+			send->InUse = false;
+			continue;
+		}
+		if (entry.Command == AtCommand::CipRxGetRead && entry.Output == &_pendingRead && _pendingRead.CallbackState == socket)
+		{
+			_pendingRead.InUse = false;
+			continue;
+		}
+		if (entry.CallbackState == socket)
+		{
+			continue;
+		}
+		if (kept != i)
+		{
+			_asyncQueue[(_asyncQueueHead + kept) % ASYNC_COMMAND_QUEUE_SIZE] = entry;
+		}
+		kept++;
+	}
+	_asyncQueueCount = kept;
+	if (!_commandInProgress)
+	{
+		return;
+	}
+	for (uint8_t i = 0; i < _commandSendCount; i++)
+	{
+		if (_commandSends[i]->CallbackState == socket)
+		{
+			_commandSends[i]->Callback = nullptr;
+			_commandSegments[i].Data = nullptr;
+		}
+	}
+	if (_commandType == AtCommand::CipRxGetRead && _pendingRead.InUse && _pendingRead.CallbackState == socket)
+	{
+		// rest of payload is dropped
+		_pendingRead.Callback = nullptr;
+		_parserContext.CipRxGetDataCapacity = _parserContext.CipRxGetDataLength;
+	}
+	if (_commandCallbackState == socket)
+	{
+		_commandCallback = nullptr;
+		if (_commandType == AtCommand::CipAck)
+		{
+			_parserContext.CipAckTxLength = nullptr;
+		}
+	}
+}
+/* lets sockets fill RX and drain TX buffers while serial port is free */
+void SimcomAtCommands::ServiceSockets()
+{
+	for (uint8_t i = 0; i < MAX_CONNECTIONS; i++)
+	{
+		const uint8_t mux = (_nextSocket + i) % MAX_CONNECTIONS;
+		if (_sockets[mux] != nullptr && _sockets[mux]->Service())
+		{
+			_nextSocket = (mux + 1) % MAX_CONNECTIONS;
+			return;
+		}
+	}
+}
+void SimcomAtCommands::ResetCommandStats()
+{
+	for (uint8_t i = 0; i < AtCommandCount; i++)
+	{
+		_commandStats[i].Reset();
+	}
+}
+void SimcomAtCommands::LogCommandStats()
+{
+	for (uint8_t i = 0; i < AtCommandCount; i++)
+	{
+		const auto &stats = _commandStats[i];
+		if (stats.Count == 0)
+		{
+			continue;
+		}
+		_logger.Log(F("%s: %lu ok, %lu error, %lu timeout, min/mean/max %lu/%lu/%lu ms"),
+			AtCommandToStr(static_cast<AtCommand>(i)),
+			static_cast<unsigned long>(stats.Successes),
+			static_cast<unsigned long>(stats.Errors),
+			static_cast<unsigned long>(stats.Timeouts),
+			static_cast<unsigned long>(stats.MinMs),
+			static_cast<unsigned long>(stats.MeanMs()),
+			static_cast<unsigned long>(stats.MaxMs));
+	}
+}
+/* 
+Drives command engine: starts queued commands, feeds parser with received bytes
+and completes current command when response is parsed or timeout elapsed
+*/
+void SimcomAtCommands::Poll()
+{
+	if (!_commandInProgress && _cipsendPaddingLeft > 0 && !WriteCipsendPadding())
+	{
+		// modem takes everything as payload until padding is written
+		ReadSerial();
+		return;
+	}
+	if (!_commandInProgress)
+	{
+		// busy sockets may keep engine from being idle after reading, events must not wait for that
+		DispatchEvents();
+	}
+	if (!_commandInProgress && _asyncQueueCount == 0 && !_waitingForQueue)
+	{
+		ServiceSockets();
+	}
+	if (!_commandInProgress && _asyncQueueCount > 0)
+	{
+		StartNextAsyncCommand();
+	}
+
+	ReadSerial();
+	CheckConnectTimeouts();
+
+	if (!_commandInProgress)
+	{
+		DispatchEvents();
+		return;
+	}
+	if (_commandType == AtCommand::CipSend && _parserContext.CipsendState == CipsendStateType::SendingData)
+	{
+		WriteCipsendData();
+		if (_parserContext.CipsendState == CipsendStateType::SendingData)
+		{
+			// modem takes whatever follows the prompt as payload until announced length,
+			// command ends only when serial port stops taking it for longer than rest of payload needs
+			const uint16_t left = _parserContext.CipsendLength - _parserContext.CipsendDataWritten;
+			if (_clock->Millis() - _commandTimeoutStart >= SerialTransferTime(left) + (unsigned long)_commandTimeout)
+			{
+				AbandonCipsend(left);
+			}
+			return;
+		}
+	}
+	const auto elapsedMs = _clock->Millis() - _commandTimeoutStart;
+	const auto echoTimeout = _timeouts.EchoTimeout();
+	if (_parser.commandReady || 
+		elapsedMs >= (unsigned long)_commandTimeout ||
+		(echoTimeout != 0 && _parser.IsWaitingForEcho() && elapsedMs >= echoTimeout))
+	{
+		if (!_parser.commandReady && _commandType == AtCommand::CipSend && _parserContext.CipsendState == CipsendStateType::WaitingForPrompt)
+		{
+			// prompt may have been lost while modem waits for payload
+			AbandonCipsend(_parserContext.CipsendLength);
+			return;
+		}
+		CompleteCommand();
+	}
+}
+/* ends CIPSEND with Timeout, remote side gets broken data so connection is closed after padding */
+void SimcomAtCommands::AbandonCipsend(uint16_t left)
+{
+	_logger.Log(F("CIPSEND abandoned, %d bytes not written"), left);
+	_cipsendPaddingMux = _parserContext.CipsendMux;
+	_cipsendPaddingLeft = left;
+	_cipsendPaddingStart = _clock->Millis();
+	// socket learns before send callback that the connection is gone
+	UnsolicitedResult closed;
+	closed.Type = UnsolicitedType::ConnectionClosed;
+	closed.Mux = _cipsendPaddingMux;
+	OnConnectionEvent(closed, this);
+	CompleteCommand();
+}
+/*
+Reads available bytes in blocks and feeds them to parser, 
+bytes received after response of current command are kept for next poll
+*/
+void SimcomAtCommands::ReadSerial()
+{
+	while (!(_commandInProgress && _parser.commandReady))
+	{
+		if (_readBufferPosition == _readBufferLength)
+		{
+			const auto available = _serial.available();
+			if (available <= 0)
+			{
+				return;
+			}
+			uint8_t *payloadBuffer;
+			const auto payloadLength = _parser.GetPayloadBuffer(payloadBuffer);
+			if (payloadLength > 0)
+			{
+				const auto payloadRead = _serial.readBytes(payloadBuffer, payloadLength < (size_t)available ? payloadLength : available);
+				TraceSerial(UartTraceDirection::Read, payloadBuffer, payloadRead);
+				_parser.PayloadReceived(payloadRead);
+				continue;
+			}
+			const auto toRead = available < SERIAL_READ_BUFFER_SIZE ? available : SERIAL_READ_BUFFER_SIZE;
+			_readBufferLength = _serial.readBytes(_readBuffer, toRead);
+			TraceSerial(UartTraceDirection::Read, _readBuffer, _readBufferLength);
+			_readBufferPosition = 0;
+			if (_readBufferLength == 0)
+			{
+				return;
+			}
+		}
+		_readBufferPosition += _parser.FeedChars(_readBuffer + _readBufferPosition, _readBufferLength - _readBufferPosition);
+	}
+}
+/*
+Writes CIPSEND payload after prompt without blocking on full TX buffer,
+rest is written on next polls. Modem answers DATA ACCEPT when whole payload is received
+*/
+void SimcomAtCommands::WriteCipsendData()
+{
+	int space = _serial.availableForWrite();
+	if (space <= 0)
+	{
+		space = SERIAL_WRITE_CHUNK_SIZE;
+	}
+	uint16_t segmentStart = 0;
+	for (uint8_t i = 0; i < _parserContext.CipsendSegmentCount && space > 0; i++)
+	{
+		const auto &segment = _parserContext.CipsendSegments[i];
+		if (_parserContext.CipsendDataWritten >= segmentStart + segment.Length)
+		{
+			segmentStart += segment.Length;
+			continue;
+		}
+		const auto offset = _parserContext.CipsendDataWritten - segmentStart;
+		size_t toWrite = segment.Length - offset < space ? segment.Length - offset : space;
+		// data of detached socket
+		const uint8_t *data = segment.Data != nullptr ? segment.Data + offset : CipsendFiller;
+		if (segment.Data == nullptr && toWrite > SERIAL_WRITE_CHUNK_SIZE)
+		{
+			toWrite = SERIAL_WRITE_CHUNK_SIZE;
+		}
+		const auto written = _serial.write(data, toWrite);
+		TraceSerial(UartTraceDirection::Write, data, written);
+		_parserContext.CipsendDataWritten += written;
+		if (written > 0)
+		{
+			_commandTimeoutStart = _clock->Millis();
+		}
+		space -= written;
+		if (written < toWrite)
+		{
+			break;
+		}
+		segmentStart += segment.Length;
+	}
+	if (_parserContext.CipsendDataWritten == _parserContext.CipsendLength)
+	{
+		_parserContext.CipsendState = CipsendStateType::WaitingForDataAccept;
+		// UART time of payload depends on its length, timeout counts only wait for DATA ACCEPT
+		_commandTimeoutStart = _clock->Millis();
+		// written payload may still be in TX buffer of serial port, with echo it also comes back before response
+		const auto transferLength = _parserContext.EchoEnabled ? 2 * _parserContext.CipsendLength : _parserContext.CipsendLength;
+		_commandTimeout += static_cast<int>(SerialTransferTime(transferLength));
+	}
+}
+/*
+modem waits for rest of abandoned CIPSEND payload and would take next commands as part of it.
+Filler completes the payload, then connection is closed as remote side got broken data.
+Returns true when done or serial port took nothing for AT_DEFAULT_TIMEOUT
+*/
+bool SimcomAtCommands::WriteCipsendPadding()
+{
+	int space = _serial.availableForWrite();
+	if (space <= 0)
+	{
+		space = SERIAL_WRITE_CHUNK_SIZE;
+	}
+	const size_t chunk = space < SERIAL_WRITE_CHUNK_SIZE ? space : SERIAL_WRITE_CHUNK_SIZE;
+	const size_t toWrite = _cipsendPaddingLeft < chunk ? _cipsendPaddingLeft : chunk;
+	const auto written = _serial.write(CipsendFiller, toWrite);
+	TraceSerial(UartTraceDirection::Write, CipsendFiller, written);
+	_cipsendPaddingLeft -= written;
+	if (written > 0)
+	{
+		_cipsendPaddingStart = _clock->Millis();
+	}
+	else if (_clock->Millis() - _cipsendPaddingStart >= (unsigned long)AT_DEFAULT_TIMEOUT)
+	{
+		_logger.Log(F("Serial port doesn't take CIPSEND padding, %d bytes left"), _cipsendPaddingLeft);
+		_cipsendPaddingLeft = 0;
+	}
+	if (_cipsendPaddingLeft > 0)
+	{
+		return false;
+	}
+	FixedString20 command;
+	command.appendFormat(F("AT+CIPCLOSE=%d"), _cipsendPaddingMux);
+	// echo is appended to echoed padding and can't be recognized
+	StartCommand(AtCommand::Cipclose, false, command.c_str());
+	return true;
+}
+/* UART time of length bytes, 10 bits per byte */
+unsigned long SimcomAtCommands::SerialTransferTime(size_t length)
+{
+	const unsigned long baudRate = _currentBaudRate != 0 ? _currentBaudRate : UNKNOWN_BAUD_RATE;
+	return (length * 10UL * 1000UL + baudRate - 1) / baudRate;
+}
+void SimcomAtCommands::TraceSerial(UartTraceDirection direction, const void *data, size_t length)
+{
+	if (_traceRecorder != nullptr)
+	{
+		_traceRecorder->Record(direction, _clock->Millis(), static_cast<const uint8_t*>(data), length);
+	}
+}
+bool SimcomAtCommands::IsBusy()
+{
+	return _commandInProgress || _asyncQueueCount > 0 || _cipsendPaddingLeft > 0;
+}
+void SimcomAtCommands::WaitForAsyncCommands()
+{
+	const auto wasWaiting = _waitingForQueue;
+	_waitingForQueue = true;
+	while (IsBusy())
+	{
+		Poll();
+		_clock->Idle();
+	}
+	_waitingForQueue = wasWaiting;
 }
 AtResultType SimcomAtCommands::GetOperatorName(FixedStringBase &operatorName, bool returnImsi)
 {	
@@ -135,10 +858,47 @@ AtResultType SimcomAtCommands::GetIpState(SimcomIpState &ipState)
 	return PopCommandResult();	
 }
 
+AtResultType SimcomAtCommands::GetConnectionsInfo(SimcomIpState &ipState, ConnectionInfo *connections)
+{
+	if (!_parserContext.Cipmux)
+	{
+		return AtResultType::Error;
+	}
+	WaitForAsyncCommands();
+	_parserContext.IpState = &ipState;
+	_parserContext.Connections = connections;
+	SendAt_P(AtCommand::Cipstatus, F("AT+CIPSTATUS"));
+	const auto result = PopCommandResult();
+	_parserContext.Connections = nullptr;
+	if (result != AtResultType::Success)
+	{
+		return result;
+	}
+	// fills in URCs that may have been lost
+	for (uint8_t mux = 0; mux < MAX_CONNECTIONS; mux++)
+	{
+		const auto state = connections[mux].State;
+		if (_connections[mux].State != ConnectionState::Connecting)
+		{
+			_connections[mux].State = state;
+		}
+		else if (state == ConnectionState::Connected)
+		{
+			CompleteConnect(mux, AtResultType::Success);
+		}
+		else if (state == ConnectionState::Closed)
+		{
+			CompleteConnect(mux, AtResultType::Error);
+		}
+	}
+	return result;
+}
+
 AtResultType SimcomAtCommands::GetIpAddress(GsmIp& ipAddress)
 {	
 	_parserContext.IpAddress = &ipAddress;
-	SendAt_P(AtCommand::Cifsr, F("AT+CIFSR;E1"));
+	// CIFSR doesn't end with OK, E command appended to it does
+	SendAt_P(AtCommand::Cifsr, F("AT+CIFSR;E%d"), _parserContext.EchoEnabled ? 1 : 0);
 	return PopCommandResult();
 }
 
@@ -206,28 +966,13 @@ AtResultType SimcomAtCommands::PopCommandResult()
 }
 AtResultType SimcomAtCommands::PopCommandResult(int timeout)
 {
-	const unsigned long start = millis();
-	while(_parser.commandReady == false && (millis()-start) < (unsigned long)timeout)
-	{
-		if(_serial.available())
-		{
-			char c = _serial.read();
-			_parser.FeedChar(c);
-		}
-	}
-
-	const auto commandResult = _parser.GetAtResultType();
-	const auto elapsedMs = millis() - start;	
-	_logger.LogAt(F("    -- %d ms --"), elapsedMs);
-	if (commandResult == AtResultType::Timeout)
-	{
-		_logger.Log(F("                      --- !!! '%s' - TIMEOUT!!! ---      "), _currentCommand.c_str(), elapsedMs);
-	}
-	if (commandResult == AtResultType::Error)
+	_commandTimeout = static_cast<int>(_timeouts.Timeout(_commandType, _currentCommand.c_str(), timeout));
+	while (_commandInProgress)
 	{
-		_logger.Log(F("                      --- !!! '%s' - ERROR!!! ---      "), _currentCommand.c_str(), elapsedMs);
+		Poll();
+		_clock->Idle();
 	}
-	return commandResult;
+	return _lastCommandResult;
 }
 /*
 Disables/enables echo on serial port
@@ -244,7 +989,11 @@ AtResultType SimcomAtCommands::SetEcho(bool echoEnabled)
 	}
 
 	auto r = PopCommandResult();
-	delay(100); // without 100ms wait, next command failed, idk wky
+	if (r == AtResultType::Success)
+	{
+		_parserContext.EchoEnabled = echoEnabled;
+	}
+	_clock->Delay(100); // without 100ms wait, next command failed, idk wky
 	return r;
 }
 
@@ -263,7 +1012,7 @@ AtResultType SimcomAtCommands::SetApn(const char *apnName, const char *username,
 AtResultType SimcomAtCommands::At()
 {	
 	SendAt_P(AtCommand::Generic, false, F("AT"));
-	return PopCommandResult(30);
+	return PopCommandResult(300);
 }
 
 void SimcomAtCommands::OnDataReceived(DataReceivedCallback onDataReceived)
@@ -271,6 +1020,21 @@ void SimcomAtCommands::OnDataReceived(DataReceivedCallback onDataReceived)
 	_parser.OnDataReceived(onDataReceived);
 }
 
+void SimcomAtCommands::SetClock(GsmClock &clock)
+{
+	_clock = &clock;
+}
+
+void SimcomAtCommands::SetTraceRecorder(UartTraceRecorder *recorder)
+{
+	_traceRecorder = recorder;
+}
+
+void SimcomAtCommands::OnUnsolicited(UnsolicitedType type, UnsolicitedCallback callback, void *state)
+{
+	_parser.OnUnsolicited(type, callback, state);
+}
+
 AtResultType SimcomAtCommands::SetBaudRate(uint32_t baud)
 {	
 	SendAt_P(AtCommand::Generic, F("AT+IPR=%d"), baud);
@@ -285,7 +1049,7 @@ bool SimcomAtCommands::EnsureModemConnected(long requestedBaudRate)
 	{
 		while (atResult != AtResultType::Success && n-- > 0)
 		{
-			delay(20);
+			_clock->Delay(20);
 			atResult = At();
 		}
 		if (atResult == AtResultType::Success || atResult == AtResultType::Error)
@@ -311,7 +1075,7 @@ bool SimcomAtCommands::EnsureModemConnected(long requestedBaudRate)
 
 	At();
 
-	if (SetEcho(true) != AtResultType::Success)
+	if (SetEcho(_useEcho) != AtResultType::Success)
 	{
 		_logger.Log(F("Failed to set echo"));
 		return false;	
@@ -328,14 +1092,11 @@ AtResultType SimcomAtCommands::GetImei(FixedString20 &imei)
 
 void SimcomAtCommands::wait(uint64_t ms)
 {
-	const unsigned long start = millis();
-	while ((millis() - start) <= ms)
+	const unsigned long start = _clock->Millis();
+	while ((_clock->Millis() - start) <= ms)
 	{
-		if (_serial.available())
-		{
-			auto c = _serial.read();
-			_parser.FeedChar(c);
-		}
+		Poll();
+		_clock->Idle();
 	}
 }
 
@@ -348,13 +1109,26 @@ AtResultType SimcomAtCommands::SendSms(char *number, char *message)
 {	
 	SendAt_P(AtCommand::Generic, F("AT+CMGS=\"%s\""), number);
 
-	const uint64_t start = millis();
+	const unsigned long start = _clock->Millis();
 	// wait for >
-	while (_serial.read() != '>')
-		if (millis() - start > 200)
+	int c;
+	while ((c = _serial.read()) != '>')
+	{
+		if (_clock->Millis() - start > 200)
 			return AtResultType::Error;
+		if (c < 0)
+		{
+			_clock->Idle();
+			continue;
+		}
+		const uint8_t received = c;
+		TraceSerial(UartTraceDirection::Read, &received, 1);
+	}
+	TraceSerial(UartTraceDirection::Read, ">", 1);
 	_serial.print(message);
 	_serial.print('\x1a');
+	TraceSerial(UartTraceDirection::Write, message, strlen(message));
+	TraceSerial(UartTraceDirection::Write, "\x1a", 1);
 	return PopCommandResult();
 }
 AtResultType SimcomAtCommands::SendUssdWaitResponse(char *ussd, FixedString150& response)
@@ -411,6 +1185,35 @@ AtResultType SimcomAtCommands::GetIncomingCall(IncomingCallInfo & callInfo)
 	return result;
 }
 
+/*
+Gets registration status, signal quality, battery status, operator name and incoming call
+in one round trip by concatenating queries in single line, parser routes every +XXX: line to its query
+*/
+AtResultType SimcomAtCommands::GetModemStatus(ModemStatus &modemStatus)
+{
+	modemStatus.CallInfo.HasIncomingCall = false;
+	modemStatus.CallInfo.CallerNumber.clear();
+	_parserContext.CsqSignalQuality = &modemStatus.SignalQuality;
+	_parserContext.BatteryInfo = &modemStatus.BatteryInfo;
+	_parserContext.OperatorName = &modemStatus.OperatorName;
+	_parserContext.CallInfo = &modemStatus.CallInfo;
+	_parserContext.BatchCommands = 
+		BatchCommandBit(AtCommand::Creg) |
+		BatchCommandBit(AtCommand::Csq) |
+		BatchCommandBit(AtCommand::Cbc) |
+		BatchCommandBit(AtCommand::Cops) |
+		BatchCommandBit(AtCommand::Clcc);
+
+	SendAt_P(AtCommand::Batch, F("AT+CREG?;+CSQ;+CBC;+COPS?;+CLCC"));
+	const auto result = PopCommandResult();
+	if (result == AtResultType::Success)
+	{
+		modemStatus.RegistrationStatus = _parserContext.RegistrationStatus;
+		modemStatus.IsOperatorNameReturnedInImsiFormat = _parserContext.IsOperatorNameReturnedInImsiFormat;
+	}
+	return result;
+}
+
 AtResultType SimcomAtCommands::Shutdown()
 {	
 	SendAt_P(AtCommand::Generic, F("AT+CPOWD=0"));
@@ -425,25 +1228,263 @@ AtResultType SimcomAtCommands::BeginConnect(ProtocolType protocol, uint8_t mux,
 	SendAt_P(AtCommand::Generic, 
 		F("AT+CIPSTART=%d,\"%s\",\"%s\",\"%d\""),
 		mux, ProtocolToStr(protocol), address, port);	
-	return PopCommandResult(60000);
+	const auto result = PopCommandResult(60000);
+	if (mux < MAX_CONNECTIONS)
+	{
+		auto &connection = _connections[mux];
+		connection.Callback = nullptr;
+		connection.ResultReady = false;
+		connection.State = result == AtResultType::Success ? ConnectionState::Connecting : ConnectionState::Closed;
+		connection.StartedAt = _clock->Millis();
+	}
+	return result;
 }
 
 AtResultType SimcomAtCommands::Read(int mux, FixedStringBase& outputBuffer)
 {
+	WaitForAsyncCommands();
 	_parserContext.CipRxGetBuffer = &outputBuffer;
+	_parserContext.CipRxGetData = nullptr;
 	SendAt_P(AtCommand::CipRxGetRead,F("AT+CIPRXGET=2,%d,%d"), mux, outputBuffer.capacity());
 	return PopCommandResult();
 }
 
+/*
+Reads binary data of connection into buffer, 
+payload is read from serial port directly into buffer
+*/
+AtResultType SimcomAtCommands::Read(int mux, uint8_t *buffer, uint16_t capacity, uint16_t &readBytes, uint16_t &dataLeft)
+{
+	readBytes = 0;
+	dataLeft = 0;
+	WaitForAsyncCommands();
+	_parserContext.CipRxGetData = buffer;
+	_parserContext.CipRxGetDataCapacity = capacity;
+	_parserContext.CipRxGetDataLength = 0;
+	_parserContext.CipRxGetDataLeft = 0;
+	SendAt_P(AtCommand::CipRxGetRead, F("AT+CIPRXGET=2,%d,%d"), mux, capacity);
+	const auto result = PopCommandResult();
+	_parserContext.CipRxGetData = nullptr;
+	if (result == AtResultType::Success)
+	{
+		readBytes = _parserContext.CipRxGetDataLength;
+		dataLeft = _parserContext.CipRxGetDataLeft;
+	}
+	return result;
+}
+
+AtResultType SimcomAtCommands::GetPendingDataLength(uint8_t mux, uint16_t &length)
+{
+	length = 0;
+	SendAt_P(AtCommand::CipRxGetLength, F("AT+CIPRXGET=4,%d"), mux);
+	const auto result = PopCommandResult();
+	if (result == AtResultType::Success)
+	{
+		length = _parserContext.CipRxGetDataLeft;
+	}
+	return result;
+}
+AtResultType SimcomAtCommands::ReadAll(uint8_t mux, uint8_t *buffer, size_t capacity, size_t &readBytes)
+{
+	readBytes = 0;
+	uint16_t pending;
+	auto result = GetPendingDataLength(mux, pending);
+	while (result == AtResultType::Success && pending > 0 && readBytes < capacity)
+	{
+		size_t chunkLength = capacity - readBytes;
+		if (chunkLength > pending)
+		{
+			chunkLength = pending;
+		}
+		if (chunkLength > CIPRXGET_MAX_LENGTH)
+		{
+			chunkLength = CIPRXGET_MAX_LENGTH;
+		}
+		uint16_t chunkRead;
+		result = Read(mux, buffer + readBytes, chunkLength, chunkRead, pending);
+		readBytes += chunkRead;
+		if (chunkRead == 0)
+		{
+			break;
+		}
+	}
+	return result;
+}
 AtResultType SimcomAtCommands::Send(int mux, FixedStringBase& data, uint16_t &sentBytes)
+{
+	SendSegment segment;
+	segment.Data = reinterpret_cast<const uint8_t*>(data.c_str());
+	segment.Length = data.length();
+	return Send(static_cast<uint8_t>(mux), &segment, 1, sentBytes);
+}
+AtResultType SimcomAtCommands::Send(uint8_t mux, const SendSegment *segments, uint8_t segmentCount, uint16_t &sentBytes)
 {
 	sentBytes = 0;
-	_parserContext.CipsendBuffer = &data;
+	WaitForAsyncCommands();
+	size_t length = 0;
+	for (uint8_t i = 0; i < segmentCount; i++)
+	{
+		length += segments[i].Length;
+	}
+	if (length == 0 || length > CIPSEND_MAX_LENGTH)
+	{
+		return AtResultType::Error;
+	}
+	_parserContext.CipsendSegments = segments;
+	_parserContext.CipsendSegmentCount = segmentCount;
+	_parserContext.CipsendMux = mux;
+	_parserContext.CipsendLength = length;
 	_parserContext.CipsendState = CipsendStateType::WaitingForPrompt;
 	_parserContext.CipsendSentBytes = &sentBytes;
-	SendAt_P(AtCommand::CipSend, F("AT+CIPSEND=%d,%d"), mux, data.length());
+	SendAt_P(AtCommand::CipSend, F("AT+CIPSEND=%d,%d"), mux, static_cast<int>(length));
 	return PopCommandResult();
 }
+AtResultType SimcomAtCommands::SendAll(uint8_t mux, const uint8_t *data, size_t length, size_t &sentBytes, 
+	SendProgressCallback progress, void *state)
+{
+	sentBytes = 0;
+	if (mux >= MAX_CONNECTIONS)
+	{
+		return AtResultType::Error;
+	}
+	WaitForAsyncCommands();
+	// CIPSEND response lost or garbled on the line is recovered from AT+CIPACK, without it failed chunk can't be sent again
+	uint32_t txBase;
+	const bool canRecover = RepeatSentDataLength(mux, 0, txBase) == AtResultType::Success;
+	uint8_t retries = 0;
+	while (sentBytes < length)
+	{
+		uint16_t window;
+		if (_sendWindows[mux] == 0)
+		{
+			// window shrinks with accepted data, modem may have sent it already
+			const auto result = GetSendWindow(mux, window);
+			if (result != AtResultType::Success)
+			{
+				// query changes nothing in modem, can be repeated
+				if (++retries > SEND_ALL_MAX_RETRIES)
+				{
+					return result;
+				}
+				continue;
+			}
+			if (window > 0)
+			{
+				continue;
+			}
+			// modem buffer is full, give it time to send some data to remote side
+			if (++retries > SEND_ALL_MAX_RETRIES)
+			{
+				return AtResultType::Error;
+			}
+			wait(SEND_ALL_RETRY_DELAY);
+			continue;
+		}
+		size_t chunkLength = length - sentBytes;
+		if (chunkLength > CIPSEND_MAX_LENGTH)
+		{
+			chunkLength = CIPSEND_MAX_LENGTH;
+		}
+		if (chunkLength > _sendWindows[mux])
+		{
+			chunkLength = _sendWindows[mux];
+		}
+		SendSegment segment;
+		segment.Data = data + sentBytes;
+		segment.Length = chunkLength;
+		uint16_t accepted;
+		const auto result = Send(mux, &segment, 1, accepted);
+		if (canRecover && (result != AtResultType::Success || accepted < chunkLength))
+		{
+			// modem may have taken more than response said, sending it again would duplicate it
+			const uint32_t confirmed = txBase + sentBytes;
+			uint32_t txLength;
+			const auto ackResult = RepeatSentDataLength(mux, confirmed, txLength);
+			if (ackResult != AtResultType::Success)
+			{
+				return result != AtResultType::Success ? result : ackResult;
+			}
+			const uint32_t taken = txLength - confirmed;
+			accepted = taken < chunkLength ? static_cast<uint16_t>(taken) : static_cast<uint16_t>(chunkLength);
+		}
+		else if (result != AtResultType::Success)
+		{
+			return result;
+		}
+		sentBytes += accepted;
+		if (accepted > 0 && progress != nullptr)
+		{
+			progress(mux, sentBytes, length, state);
+		}
+		if (accepted == chunkLength)
+		{
+			retries = 0;
+			continue;
+		}
+		// rest of chunk goes with next one, sized to what modem can take now
+		_logger.Log(F("CIPSEND accepted %d of %d bytes"), accepted, static_cast<int>(chunkLength));
+		if (accepted > 0)
+		{
+			retries = 0;
+		}
+		else if (++retries > SEND_ALL_MAX_RETRIES)
+		{
+			return AtResultType::Error;
+		}
+		const auto windowResult = GetSendWindow(mux, window);
+		if (windowResult != AtResultType::Success && ++retries > SEND_ALL_MAX_RETRIES)
+		{
+			return windowResult;
+		}
+	}
+	return AtResultType::Success;
+}
+AtResultType SimcomAtCommands::GetSendWindow(uint8_t mux, uint16_t &window)
+{
+	if (mux >= MAX_CONNECTIONS)
+	{
+		return AtResultType::Error;
+	}
+	SendAt_P(AtCommand::CipSendQuery, F("AT+CIPSEND?"));
+	const auto result = PopCommandResult();
+	window = _sendWindows[mux];
+	return result;
+}
+
+AtResultType SimcomAtCommands::GetSentDataLength(uint8_t mux, uint32_t &txLength)
+{
+	if (mux >= MAX_CONNECTIONS)
+	{
+		return AtResultType::Error;
+	}
+	_parserContext.CipAckTxLength = &txLength;
+	if (_parserContext.Cipmux)
+	{
+		SendAt_P(AtCommand::CipAck, F("AT+CIPACK=%d"), mux);
+	}
+	else
+	{
+		SendAt_P(AtCommand::CipAck, F("AT+CIPACK"));
+	}
+	const auto result = PopCommandResult();
+	_parserContext.CipAckTxLength = nullptr;
+	return result;
+}
+
+/* AT+CIPACK changes nothing in modem, it is repeated on lost response or garbled counter below minimum */
+AtResultType SimcomAtCommands::RepeatSentDataLength(uint8_t mux, uint32_t minimum, uint32_t &txLength)
+{
+	auto result = AtResultType::Error;
+	for (uint8_t attempt = 0; attempt <= SEND_ALL_MAX_RETRIES; attempt++)
+	{
+		result = GetSentDataLength(mux, txLength);
+		if (result == AtResultType::Success && txLength >= minimum)
+		{
+			return result;
+		}
+	}
+	return result == AtResultType::Success ? AtResultType::Error : result;
+}
 
 AtResultType SimcomAtCommands::CloseConnection(uint8_t mux)
 {	
@@ -458,41 +1499,144 @@ AtResultType SimcomAtCommands::GetConnectionInfo(uint8_t mux, ConnectionInfo &co
 	return PopCommandResult();
 }
 
+bool SimcomAtCommands::GenericAtAsync(int timeout, AtCommandCallback callback, void *state, const __FlashStringHelper* command, ...)
+{
+	va_list argptr;
+	va_start(argptr, command);
+	FixedString100 buffer;
+	buffer.appendFormatV(command, argptr);
+	va_end(argptr);
 
+	return EnqueueAt_P(AtCommand::Generic, timeout, nullptr, callback, state, F("%s"), buffer.c_str());
+}
 
+bool SimcomAtCommands::GetSignalQualityAsync(int16_t &signalQuality, AtCommandCallback callback, void *state)
+{
+	return EnqueueAt_P(AtCommand::Csq, AT_DEFAULT_TIMEOUT, &signalQuality, callback, state, F("AT+CSQ"));
+}
 
+bool SimcomAtCommands::GetBatteryStatusAsync(BatteryStatus &batteryStatus, AtCommandCallback callback, void *state)
+{
+	return EnqueueAt_P(AtCommand::Cbc, AT_DEFAULT_TIMEOUT, &batteryStatus, callback, state, F("AT+CBC"));
+}
 
+bool SimcomAtCommands::GetIpStateAsync(SimcomIpState &ipState, AtCommandCallback callback, void *state)
+{
+	return EnqueueAt_P(AtCommand::Cipstatus, AT_DEFAULT_TIMEOUT, &ipState, callback, state, F("AT+CIPSTATUS"));
+}
 
+bool SimcomAtCommands::GetSentDataLengthAsync(uint8_t mux, uint32_t &txLength, AtCommandCallback callback, void *state)
+{
+	if (mux >= MAX_CONNECTIONS)
+	{
+		return false;
+	}
+	if (_parserContext.Cipmux)
+	{
+		return EnqueueAt_P(AtCommand::CipAck, AT_DEFAULT_TIMEOUT, &txLength, callback, state, F("AT+CIPACK=%d"), mux);
+	}
+	return EnqueueAt_P(AtCommand::CipAck, AT_DEFAULT_TIMEOUT, &txLength, callback, state, F("AT+CIPACK"));
+}
 
+bool SimcomAtCommands::AttachGprsAsync(AtCommandCallback callback, void *state)
+{
+	return EnqueueAt_P(AtCommand::Generic, 60000, nullptr, callback, state, F("AT+CIICR"));
+}
 
+bool SimcomAtCommands::CipshutAsync(AtCommandCallback callback, void *state)
+{
+	return EnqueueAt_P(AtCommand::Cipshut, 20000, nullptr, callback, state, F("AT+CIPSHUT"));
+}
 
+bool SimcomAtCommands::CloseConnectionAsync(uint8_t mux, AtCommandCallback callback, void *state)
+{
+	if (mux >= MAX_CONNECTIONS)
+	{
+		return false;
+	}
+	return EnqueueAt_P(AtCommand::Cipclose, AT_DEFAULT_TIMEOUT, nullptr, callback, state, F("AT+CIPCLOSE=%d"), mux);
+}
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+bool SimcomAtCommands::BeginConnectAsync(ProtocolType protocol, uint8_t mux, const char *address, int port, AtCommandCallback callback, void *state)
+{
+	return EnqueueAt_P(AtCommand::Generic, 60000, nullptr, callback, state,
+		F("AT+CIPSTART=%d,\"%s\",\"%s\",\"%d\""),
+		mux, ProtocolToStr(protocol), address, port);
+}
+bool SimcomAtCommands::ConnectAsync(ProtocolType protocol, uint8_t mux, const char *address, int port, ConnectCallback callback, void *state)
+{
+	// callback of previous connect may not have been called yet
+	if (mux >= MAX_CONNECTIONS || _connections[mux].State == ConnectionState::Connecting || _connections[mux].ResultReady)
+	{
+		return false;
+	}
+	auto &connection = _connections[mux];
+	if (!EnqueueAt_P(AtCommand::Generic, 60000, nullptr, OnCipstartCompleted, &connection,
+		F("AT+CIPSTART=%d,\"%s\",\"%s\",\"%d\""),
+		mux, ProtocolToStr(protocol), address, port))
+	{
+		return false;
+	}
+	// URC timeout counts from queueing, CIPSTART itself is answered quickly
+	connection.State = ConnectionState::Connecting;
+	connection.StartedAt = _clock->Millis();
+	connection.Callback = callback;
+	connection.CallbackState = state;
+	return true;
+}
+bool SimcomAtCommands::SendAsync(uint8_t mux, const uint8_t *data, uint16_t length, SendCallback callback, void *state)
+{
+	if (mux >= MAX_CONNECTIONS || length == 0 || length > CIPSEND_MAX_LENGTH)
+	{
+		return false;
+	}
+	if (length > SendWindowLeft(mux))
+	{
+		// modem may have sent buffered data since window was queried
+		RefreshSendWindow();
+		return false;
+	}
+	PendingSend *send = nullptr;
+	for (auto &slot : _sendQueue)
+	{
+		if (!slot.InUse)
+		{
+			send = &slot;
+			break;
+		}
+	}
+	if (send == nullptr)
+	{
+		return false;
+	}
+	send->Mux = mux;
+	send->Data = data;
+	send->Length = length;
+	send->Callback = callback;
+	send->CallbackState = state;
+	if (!EnqueueAt_P(AtCommand::CipSend, AT_DEFAULT_TIMEOUT, send, nullptr, nullptr, nullptr))
+	{
+		return false;
+	}
+	send->InUse = true;
+	_sendsInFlight[mux] += length;
+	return true;
+}
+bool SimcomAtCommands::ReadAsync(uint8_t mux, uint8_t *buffer, uint16_t capacity, ReadCallback callback, void *state)
+{
+	if (_pendingRead.InUse || mux >= MAX_CONNECTIONS || capacity == 0)
+	{
+		return false;
+	}
+	_pendingRead.Mux = mux;
+	_pendingRead.Buffer = buffer;
+	_pendingRead.Capacity = capacity;
+	_pendingRead.Callback = callback;
+	_pendingRead.CallbackState = state;
+	if (!EnqueueAt_P(AtCommand::CipRxGetRead, AT_DEFAULT_TIMEOUT, &_pendingRead, OnReadCompleted, this, F("AT+CIPRXGET=2,%d,%d"), mux, capacity))
+	{
+		return false;
+	}
+	_pendingRead.InUse = true;
+	return true;
+}
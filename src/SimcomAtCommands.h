@@ -9,6 +9,9 @@
 #include "Parsing/SimcomResponseParser.h"
 #include "Parsing/ParserContext.h"
 #include "GsmLogger.h"
+#include "GsmClock.h"
+#include "AdaptiveTimeout.h"
+#include "UartTraceRecorder.h"
 #include "SimcomGsmTypes.h"
 #include <pgmspace.h>
 
@@ -16,17 +19,131 @@ class S900Socket;
 
 class SimcomAtCommands
 {
+	friend class S900Socket;
 private:
+		struct AsyncCommand
+		{
+			AtCommand Command;
+			int Timeout;
+			void *Output;
+			AtCommandCallback Callback;
+			void *CallbackState;
+			FixedString100 CommandStr;
+		};
+		struct PendingRead
+		{
+			bool InUse;
+			uint8_t Mux;
+			uint8_t *Buffer;
+			uint16_t Capacity;
+			ReadCallback Callback;
+			void *CallbackState;
+		};
+		struct TrackedConnection
+		{
+			SimcomAtCommands *Owner;
+			uint8_t Mux;
+			ConnectionState State;
+			unsigned long StartedAt;
+			ConnectCallback Callback;
+			void *CallbackState;
+			// connect finished, callback waits for DispatchEvents()
+			bool ResultReady;
+			AtResultType Result;
+		};
+		struct PendingSend
+		{
+			bool InUse;
+			uint8_t Mux;
+			const uint8_t *Data;
+			uint16_t Length;
+			SendCallback Callback;
+			void *CallbackState;
+		};
 		Stream &_serial;
 		int _currentBaudRate;
 		GsmLogger _logger;
 		SimcomResponseParser _parser;
 		UpdateBaudRateCallback _updateBaudRateCallback;
 		ParserContext _parserContext;
-		FixedString50 _currentCommand;
+		FixedString200 _currentCommand;
+		GsmClock *_clock;
+		bool _useEcho;
+		UartTraceRecorder *_traceRecorder;
+
+		uint8_t _readBuffer[SERIAL_READ_BUFFER_SIZE];
+		uint8_t _readBufferPosition;
+		uint8_t _readBufferLength;
+
+		AsyncCommand _asyncQueue[ASYNC_COMMAND_QUEUE_SIZE];
+		uint8_t _asyncQueueHead;
+		uint8_t _asyncQueueCount;
+
+		bool _commandInProgress;
+		AtCommand _commandType;
+		unsigned long _commandStart;
+		// restarted when CIPSEND payload is written
+		unsigned long _commandTimeoutStart;
+		// rest of stalled CIPSEND payload, modem still waits for it
+		uint16_t _cipsendPaddingLeft;
+		uint8_t _cipsendPaddingMux;
+		unsigned long _cipsendPaddingStart;
+		int _commandTimeout;
+		AtCommandCallback _commandCallback;
+		void *_commandCallbackState;
+		void *_commandPreviousOutput;
+		AtResultType _lastCommandResult;
+		// CIPSEND in progress, consecutive queued sends of same mux are merged into one
+		SendSegment _commandSegments[SEND_QUEUE_SIZE];
+		PendingSend *_commandSends[SEND_QUEUE_SIZE];
+		uint8_t _commandSendCount;
+		uint16_t _commandSentBytes;
+
+		PendingSend _sendQueue[SEND_QUEUE_SIZE];
+		uint16_t _sendWindows[MAX_CONNECTIONS];
+		uint16_t _sendsInFlight[MAX_CONNECTIONS];
+		bool _sendWindowQueryQueued;
+		unsigned long _sendWindowQueriedAt;
+		PendingRead _pendingRead;
+		// state of every mux from CIPSTART result and connection URCs
+		TrackedConnection _connections[MAX_CONNECTIONS];
+		S900Socket *_sockets[MAX_CONNECTIONS];
+		// round robin start of socket servicing
+		uint8_t _nextSocket;
+		// sockets don't queue commands while blocking command waits for the queue
+		bool _waitingForQueue;
+		AtCommandStats _commandStats[AtCommandCount];
+		AdaptiveTimeout _timeouts;
 
 		void SendAt_P(AtCommand commandType, const __FlashStringHelper *command, ...);
 		void SendAt_P(AtCommand commandType, bool expectEcho, const __FlashStringHelper *command, ...);
+		void SendAtV(AtCommand commandType, bool expectEcho, const __FlashStringHelper *command, va_list args);
+		bool EnqueueAt_P(AtCommand commandType, int timeout, void *output, AtCommandCallback callback, void *state, const __FlashStringHelper *command, ...);
+		void StartCommand(AtCommand commandType, bool expectEcho, const char *command);
+		void StartNextAsyncCommand();
+		void StartQueuedSends(PendingSend *first, int timeout);
+		void* BindOutput(AtCommand commandType, void *output);
+		void CompleteCommand();
+		void CompleteSend(AtResultType result);
+		AtResultType RepeatSentDataLength(uint8_t mux, uint32_t minimum, uint32_t &txLength);
+		static void OnSendWindowQueried(AtCommand command, AtResultType result, void *state);
+		static void OnReadCompleted(AtCommand command, AtResultType result, void *state);
+		static void OnConnectionEvent(UnsolicitedResult &result, void *state);
+		static void OnCipstartCompleted(AtCommand command, AtResultType result, void *state);
+		void CompleteConnect(uint8_t mux, AtResultType result);
+		void DispatchEvents();
+		void CheckConnectTimeouts();
+		void AttachSocket(S900Socket &socket);
+		void DetachSocket(S900Socket &socket);
+		void CancelSocketCommands(void *socket);
+		void ServiceSockets();
+		void WaitForAsyncCommands();
+		void ReadSerial();
+		void WriteCipsendData();
+		bool WriteCipsendPadding();
+		void AbandonCipsend(uint16_t left);
+		unsigned long SerialTransferTime(size_t length);
+		void TraceSerial(UartTraceDirection direction, const void *data, size_t length);
 
 		AtResultType PopCommandResult(int timeout);
 		AtResultType PopCommandResult();		
@@ -35,15 +152,93 @@ public:
 		{
 			return _logger;
 		}
+		GsmClock& Clock()
+		{
+			return *_clock;
+		}
+		void SetClock(GsmClock &clock);
+		/* policy deriving command timeouts from observed latency, timeouts passed by callers are its ceilings */
+		AdaptiveTimeout& Timeouts()
+		{
+			return _timeouts;
+		}
+		/* records all serial traffic, nullptr stops recording */
+		void SetTraceRecorder(UartTraceRecorder *recorder);
+		/* latency and result counters of every command type, collected since start or last reset */
+		const AtCommandStats& GetCommandStats(AtCommand command) const
+		{
+			return _commandStats[static_cast<uint8_t>(command)];
+		}
+		void ResetCommandStats();
+		void LogCommandStats();
 		bool IsAsync;
 		SimcomAtCommands(Stream& serial, UpdateBaudRateCallback updateBaudRateCallback);
 
 		// Serial methods
+		/* echo mode set by EnsureModemConnected, ATE0 halves command traffic and CIPSEND payload isn't sent back */
+		void UseEcho(bool useEcho)
+		{
+			_useEcho = useEcho;
+		}
 		bool EnsureModemConnected(long requestedBaudRate);
 		int FindCurrentBaudRate();
 		void OnDataReceived(DataReceivedCallback onDataReceived);
+		/* 
+		handler is called from Poll() or before next blocking command is sent, never while a command waits for
+		its response, so it may call blocking and async commands
+		*/
+		void OnUnsolicited(UnsolicitedType type, UnsolicitedCallback callback, void *state = nullptr);
 		bool GarbageOnSerialDetected();
 
+		// Asynchronous command engine
+		void Poll();
+		bool IsBusy();
+		bool GenericAtAsync(int timeout, AtCommandCallback callback, void *state, const __FlashStringHelper* command, ...);
+		bool GetSignalQualityAsync(int16_t &signalQuality, AtCommandCallback callback, void *state = nullptr);
+		bool GetBatteryStatusAsync(BatteryStatus &batteryStatus, AtCommandCallback callback, void *state = nullptr);
+		bool GetIpStateAsync(SimcomIpState &ipState, AtCommandCallback callback, void *state = nullptr);
+		bool GetSentDataLengthAsync(uint8_t mux, uint32_t &txLength, AtCommandCallback callback, void *state = nullptr);
+		bool AttachGprsAsync(AtCommandCallback callback, void *state = nullptr);
+		bool CipshutAsync(AtCommandCallback callback, void *state = nullptr);
+		bool CloseConnectionAsync(uint8_t mux, AtCommandCallback callback = nullptr, void *state = nullptr);
+		bool BeginConnectAsync(ProtocolType protocol, uint8_t mux, const char *address, int port, AtCommandCallback callback, void *state = nullptr);
+		/* 
+		queues CIPSTART in multi connection mode, callback comes with CONNECT OK/CONNECT FAIL URC of the mux 
+		or after CONNECT_TIMEOUT. It is called from Poll() like URC handlers and may send commands. 
+		Several muxes can connect at the same time
+		*/
+		bool ConnectAsync(ProtocolType protocol, uint8_t mux, const char *address, int port, ConnectCallback callback, void *state = nullptr);
+		/* tracked from CIPSTART and URCs, Initial until first connect of the mux */
+		ConnectionState GetConnectionState(uint8_t mux)
+		{
+			return mux < MAX_CONNECTIONS ? _connections[mux].State : ConnectionState::Initial;
+		}
+		/* 
+		queues CIPSEND of caller's buffer, which must stay valid until callback. Several sends can be queued per mux,
+		consecutive ones are merged into single CIPSEND of up to CIPSEND_MAX_LENGTH bytes and DATA ACCEPT length
+		is split back between them in order. Returns false when queue is full or bytes not yet accepted 
+		would exceed send window of mux
+		*/
+		bool SendAsync(uint8_t mux, const uint8_t *data, uint16_t length, SendCallback callback, void *state = nullptr);
+		/* true after +CIPRXGET: 1,<mux> notification until read empties modem buffer of connection (manual RX mode) */
+		bool IsDataPending(uint8_t mux)
+		{
+			return mux < MAX_CONNECTIONS && (_parserContext.RxDataPending & (1 << mux)) != 0;
+		}
+		/* queues AT+CIPRXGET=2 into caller's buffer, only one read can be queued at a time */
+		bool ReadAsync(uint8_t mux, uint8_t *buffer, uint16_t capacity, ReadCallback callback, void *state = nullptr);
+		/* bytes SendAsync can still queue for mux, 0 when queried window is smaller than bytes in flight */
+		uint16_t SendWindowLeft(uint8_t mux)
+		{
+			if (mux >= MAX_CONNECTIONS || _sendsInFlight[mux] >= _sendWindows[mux])
+			{
+				return 0;
+			}
+			return _sendWindows[mux] - _sendsInFlight[mux];
+		}
+		/* window is lowered by data modem accepted, queues AT+CIPSEND? to learn how much it has sent since */
+		bool RefreshSendWindow();
+
 		// Standard modem functions
 		AtResultType SetBaudRate(uint32_t baud);
 
@@ -64,6 +259,7 @@ public:
 		AtResultType SendSms(char *number, char *message);
 		AtResultType Call(char *number);
 		AtResultType GetIncomingCall(IncomingCallInfo &callInfo);
+		AtResultType GetModemStatus(ModemStatus &modemStatus);
 		
 		// USSD
 		AtResultType SendUssdWaitResponse(char *ussd, FixedString150& response);
@@ -79,9 +275,35 @@ public:
 		AtResultType SetTransparentMode(bool transparentMode);
 		AtResultType BeginConnect(ProtocolType protocol, uint8_t mux, const char *address, int port);
 		AtResultType Read(int mux, FixedStringBase& outputBuffer);
+		AtResultType Read(int mux, uint8_t *buffer, uint16_t capacity, uint16_t &readBytes, uint16_t &dataLeft);
+		/* AT+CIPRXGET=4, number of received bytes modem holds for connection */
+		AtResultType GetPendingDataLength(uint8_t mux, uint16_t &length);
+		/* 
+		drains connection into buffer with fewest CIPRXGET reads: pending length is queried once, 
+		then every read takes up to CIPRXGET_MAX_LENGTH bytes and its dataLeft tells if next one is needed
+		*/
+		AtResultType ReadAll(uint8_t mux, uint8_t *buffer, size_t capacity, size_t &readBytes);
 		AtResultType Send(int mux, FixedStringBase& data, uint16_t &sentBytes);
+		/* 
+		vectored send, segments (e.g. header, body and checksum) are written back to back as payload 
+		of one CIPSEND without being copied together. Total length is limited to CIPSEND_MAX_LENGTH
+		*/
+		AtResultType Send(uint8_t mux, const SendSegment *segments, uint8_t segmentCount, uint16_t &sentBytes);
+		/* 
+		sends buffer of any length in CIPSEND chunks sized to send window of mux. Bytes not accepted by 
+		DATA ACCEPT are sent again in next chunk, sentBytes is what modem accepted before error.
+		Chunk without response is sent again only for bytes AT+CIPACK doesn't count
+		*/
+		AtResultType SendAll(uint8_t mux, const uint8_t *data, size_t length, size_t &sentBytes, 
+			SendProgressCallback progress = nullptr, void *state = nullptr);
+		/* updates send window of mux from AT+CIPSEND?, until queried window is assumed to be CIPSEND_MAX_LENGTH */
+		AtResultType GetSendWindow(uint8_t mux, uint16_t &window);
+		/* txlen of AT+CIPACK, bytes modem took for sending since connection was started */
+		AtResultType GetSentDataLength(uint8_t mux, uint32_t &txLength);
 		AtResultType CloseConnection(uint8_t mux);
 		AtResultType GetConnectionInfo(uint8_t mux, ConnectionInfo &connectionInfo);
+		/* IP state and all MAX_CONNECTIONS entries of connections from single AT+CIPSTATUS, multi connection mode only */
+		AtResultType GetConnectionsInfo(SimcomIpState &ipState, ConnectionInfo *connections);
 
 		// GPRS
 		AtResultType SetApn(const char *apnName, const char *username, const char *password);
@@ -59,6 +59,7 @@ public:
 		Mux = 0;
 		Bearer = 0;
 		Port = 0;
+		State = ConnectionState::Initial;
 	}
 	uint8_t Mux;
 	uint8_t Bearer;
@@ -98,9 +99,20 @@ enum class AtCommand : uint8_t
 	CipRxGet,
 	CipRxGetRead,
 	CipQsendQuery,
-	CipSend
+	CipSend,
+	CipSendQuery,
+	CipRxGetLength,
+	CipAck,
+	Batch
 };
 
+const uint8_t AtCommandCount = static_cast<uint8_t>(AtCommand::Batch) + 1;
+
+inline uint32_t BatchCommandBit(AtCommand command)
+{
+	return 1UL << static_cast<uint8_t>(command);
+}
+
 enum class SimcomIpState : uint8_t
 {
 	IpInitial,
@@ -134,6 +146,89 @@ enum class AtResultType : uint8_t
 	Timeout
 };
 
+typedef void(*AtCommandCallback)(AtCommand command, AtResultType result, void* state);
+// sentBytes is length from DATA ACCEPT, can be less than submitted
+typedef void(*SendCallback)(uint8_t mux, AtResultType result, uint16_t sentBytes, void* state);
+// readBytes were stored in buffer, dataLeft is what modem still holds for connection
+typedef void(*ReadCallback)(uint8_t mux, AtResultType result, uint16_t readBytes, uint16_t dataLeft, void* state);
+// Success on CONNECT OK or ALREADY CONNECT, Error when CIPSTART failed or CONNECT FAIL, Timeout when URC didn't come
+typedef void(*ConnectCallback)(uint8_t mux, AtResultType result, void* state);
+// called by SendAll() after every chunk accepted by modem
+typedef void(*SendProgressCallback)(uint8_t mux, size_t sentBytes, size_t totalBytes, void* state);
+
+// log2 latency buckets: 0 is under 1 ms, n is [2^(n-1), 2^n) ms, last one collects everything longer
+const uint8_t AtCommandStatsHistogramSize = 16;
+
+class AtCommandStats
+{
+public:
+	AtCommandStats()
+	{
+		Reset();
+	}
+	void Reset()
+	{
+		Count = 0;
+		Successes = 0;
+		Errors = 0;
+		Timeouts = 0;
+		MinMs = 0;
+		MaxMs = 0;
+		TotalMs = 0;
+		for (uint8_t i = 0; i < AtCommandStatsHistogramSize; i++)
+		{
+			Histogram[i] = 0;
+		}
+	}
+	void Record(AtResultType result, uint32_t elapsedMs)
+	{
+		if (Count == 0 || elapsedMs < MinMs)
+		{
+			MinMs = elapsedMs;
+		}
+		if (elapsedMs > MaxMs)
+		{
+			MaxMs = elapsedMs;
+		}
+		Count++;
+		TotalMs += elapsedMs;
+		switch (result)
+		{
+		case AtResultType::Success: Successes++; break;
+		case AtResultType::Error: Errors++; break;
+		case AtResultType::Timeout: Timeouts++; break;
+		}
+		auto &bucket = Histogram[HistogramBucket(elapsedMs)];
+		if (bucket != UINT16_MAX)
+		{
+			bucket++;
+		}
+	}
+	uint32_t MeanMs() const
+	{
+		return Count == 0 ? 0 : static_cast<uint32_t>(TotalMs / Count);
+	}
+	static uint8_t HistogramBucket(uint32_t elapsedMs)
+	{
+		uint8_t bucket = 0;
+		while (elapsedMs > 0 && bucket < AtCommandStatsHistogramSize - 1)
+		{
+			elapsedMs >>= 1;
+			bucket++;
+		}
+		return bucket;
+	}
+	uint32_t Count;
+	uint32_t Successes;
+	uint32_t Errors;
+	uint32_t Timeouts;
+	uint32_t MinMs;
+	uint32_t MaxMs;
+	uint64_t TotalMs;
+	// saturates at UINT16_MAX
+	uint16_t Histogram[AtCommandStatsHistogramSize];
+};
+
 enum class GsmRegistrationState : uint8_t
 {
 	SearchingForNetwork,
@@ -143,9 +238,17 @@ enum class GsmRegistrationState : uint8_t
 	Roaming
 };
 
+/* part of CIPSEND payload, segments are written back to back */
+struct SendSegment
+{
+	const uint8_t *Data;
+	uint16_t Length;
+};
+
 enum class CipsendStateType: uint8_t
 {
 	WaitingForPrompt,
+	SendingData,
 	WaitingForDataAccept,
 };
 
@@ -160,5 +263,59 @@ public:
 	FixedString20 CallerNumber;
 };
 
+enum class UnsolicitedType : uint8_t
+{
+	Ring,
+	CallerId,
+	NewSms,
+	RegistrationChanged,
+	ConnectOk,
+	ConnectFail,
+	AlreadyConnected,
+	ConnectionClosed,
+	DataReceived,
+	PdpDeact,
+	UnderVoltage
+};
+
+const uint8_t UnsolicitedTypeCount = static_cast<uint8_t>(UnsolicitedType::UnderVoltage) + 1;
+
+class UnsolicitedResult
+{
+public:
+	UnsolicitedResult()
+	{
+		Type = UnsolicitedType::Ring;
+		Mux = 0;
+		Value = 0;
+	}
+	UnsolicitedType Type;
+	// connection number of ConnectOk, ConnectFail, AlreadyConnected, ConnectionClosed and DataReceived
+	uint8_t Mux;
+	// sms index of NewSms, registration status of RegistrationChanged, data length of +RECEIVE, 1 if UnderVoltage is power down
+	uint16_t Value;
+	// caller number of CallerId, sms storage of NewSms
+	FixedString20 Text;
+};
+
+typedef void(*UnsolicitedCallback)(UnsolicitedResult& result, void* state);
+
+class ModemStatus
+{
+public:
+	ModemStatus()
+	{
+		SignalQuality = 0;
+		RegistrationStatus = GsmRegistrationState::SearchingForNetwork;
+		IsOperatorNameReturnedInImsiFormat = false;
+	}
+	GsmRegistrationState RegistrationStatus;
+	int16_t SignalQuality;
+	BatteryStatus BatteryInfo;
+	FixedString20 OperatorName;
+	bool IsOperatorNameReturnedInImsiFormat;
+	IncomingCallInfo CallInfo;
+};
+
 
 #endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "UartTraceRecorder.h"
+
+#include <string.h>
+
+UartTraceRecorder::UartTraceRecorder(Print &output) :
+	_output(output),
+	_lastTimestamp(0),
+	_headerWritten(false)
+{
+}
+
+void UartTraceRecorder::WriteVarint(uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		_output.write(static_cast<uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	_output.write(static_cast<uint8_t>(value));
+}
+
+void UartTraceRecorder::Record(UartTraceDirection direction, unsigned long timestamp, const uint8_t *data, size_t length)
+{
+	if (length == 0)
+	{
+		return;
+	}
+	if (!_headerWritten)
+	{
+		_output.write(reinterpret_cast<const uint8_t*>(UART_TRACE_MAGIC), strlen(UART_TRACE_MAGIC));
+		_output.write(static_cast<uint8_t>(UART_TRACE_VERSION));
+		_lastTimestamp = timestamp;
+		_headerWritten = true;
+	}
+	_output.write(static_cast<uint8_t>(direction));
+	WriteVarint(timestamp - _lastTimestamp);
+	WriteVarint(length);
+	_output.write(data, length);
+	_lastTimestamp = timestamp;
+}
@@ -0,0 +1,34 @@
+#ifndef _UART_TRACE_RECORDER_H
+#define _UART_TRACE_RECORDER_H
+
+#include <Print.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+Compact binary trace of serial traffic between library and modem:
+	header: 'G' 'S' 'M' 'T' <version>
+	record: <direction> <ms since previous record> <length> <data>
+delta and length are LEB128 varints, so short records take 3 bytes of overhead
+*/
+#define UART_TRACE_MAGIC "GSMT"
+#define UART_TRACE_VERSION 1
+
+enum class UartTraceDirection : uint8_t
+{
+	Read = 0,
+	Write = 1
+};
+
+class UartTraceRecorder
+{
+	Print &_output;
+	unsigned long _lastTimestamp;
+	bool _headerWritten;
+	void WriteVarint(uint32_t value);
+public:
+	UartTraceRecorder(Print &output);
+	void Record(UartTraceDirection direction, unsigned long timestamp, const uint8_t *data, size_t length);
+};
+
+#endif